@@ -0,0 +1,788 @@
+#!/usr/bin/env python3
+#
+# an/wcet.py - Worst-case timing of the attack path, from avr-objdump -d
+#
+# Written 2026 by agent
+# Copyright 2026 agent
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+
+#
+# We follow the code from the transceiver's interrupt vector to attack(), and
+# through attack() until it raises SLP_TR or returns, keeping the earliest and
+# latest cycle count since the IRQ edge. Along the way, we watch the SPI
+# interface: nSS going low starts a transfer, the first byte written is the
+# command, and if that's BUF_READ, the next bytes are the PHR and the PSDU.
+#
+# RX_START comes when the PHR is in, so PSDU byte k is complete (k+1) byte
+# times after the IRQ. A frame buffer read of a byte that isn't there yet
+# returns garbage, so reading a byte too early is an error. The attacks pace
+# themselves with _delay_us and fall a little behind with every byte, which
+# is harmless, so we only report how far behind they get. Raising SLP_TR
+# decides the attack, and a jam or reply must get on the air while the frame
+# is still coming in: at least the FCS follows the last byte read, so SLP_TR
+# plus the TX start-up time must come before it has passed.
+#
+# Paths meeting at the same place, in the same state, are merged, with the
+# cycle counts becoming ranges. Loops are handled as follows:
+#
+# - a loop polling the SPI status register takes until the byte is done,
+# - a countdown loop with a constant count (_delay_us) takes what it counts,
+# - any other loop needs a bound, with -l function=iterations.
+#
+# Functions that don't touch SPI or SLP_TR are reduced to their shortest and
+# longest time. The cycle counts are those of the megaAVR core with a 16 bit
+# PC (ATmega32U2, AT90USB1287).
+#
+
+import sys
+import re
+import getopt
+import subprocess
+import heapq
+
+
+BOARDS = {
+    # SPI data and status as (space, address), pins as (I/O port, bit)
+    "atusb": {
+        "data": ("mem", 0xce), "status": ("mem", 0xc8),		# UDR1, UCSR1A
+        "nss": (0x0b, 1), "slp_tr": (0x05, 4),
+        "spi_cycles": 16,
+    },
+    "rzusb": {
+        "data": ("io", 0x2e), "status": ("io", 0x2d),		# SPDR, SPSR
+        "nss": (0x05, 0), "slp_tr": (0x05, 4),
+        "spi_cycles": 16,
+    },
+    "hulusb": {
+        "data": ("io", 0x2e), "status": ("io", 0x2d),
+        "nss": (0x05, 0), "slp_tr": (0x05, 4),
+        "spi_cycles": 16,
+    },
+}
+
+BUF_READ = 0x20
+IRQ_RESPONSE = 5 + 3		# interrupt response plus JMP in the vector
+IRQ_RESPONSE_MAX = IRQ_RESPONSE + 3	# instruction in progress
+FCS = 2
+
+
+# ----- Disassembly -----------------------------------------------------------
+
+
+class Insn:
+    def __init__(self, addr, size, op, args, func):
+        self.addr = addr
+        self.size = size
+        self.op = op
+        self.args = args
+        self.func = func
+        self.target = None
+
+    def __str__(self):
+        return "%s+0x%x" % (self.func, self.addr - funcs[self.func])
+
+
+insns = {}		# address -> Insn
+funcs = {}		# name -> address
+func_end = {}		# name -> first address after the function
+order = []		# addresses, ascending
+
+
+def parse_int(s):
+    s = s.strip()
+    return int(s, 16) if s.lower().startswith("0x") else int(s)
+
+
+def disassemble(f):
+    func = None
+    for line in f:
+        line = line.rstrip("\n")
+        m = re.match(r"^([0-9a-f]+) <(.+)>:$", line)
+        if m:
+            func = m.group(2)
+            funcs[func] = int(m.group(1), 16)
+            continue
+        parts = line.split("\t")
+        if func is None or len(parts) < 3:
+            continue
+        m = re.match(r"^\s*([0-9a-f]+):$", parts[0])
+        if not m or not re.match(r"^([0-9a-f]{2} )+\s*$", parts[1] + " "):
+            continue
+        addr = int(m.group(1), 16)
+        size = len(parts[1].split()) // 2
+        op = parts[2].strip()
+        args = [a.strip() for a in
+            parts[3].split(";")[0].split(",")] if len(parts) > 3 else []
+        args = [a for a in args if a]
+        insn = Insn(addr, size, op, args, func)
+        if op in ("rjmp", "rcall") or op.startswith("br"):
+            m = re.match(r"^\.([+-]\d+)$", args[-1])
+            if m:
+                insn.target = addr + 2 + int(m.group(1))
+        elif op in ("jmp", "call"):
+            insn.target = parse_int(args[0])
+        insns[addr] = insn
+    order.extend(sorted(insns))
+    names = sorted(funcs.items(), key = lambda x: x[1])
+    for i in range(len(names)):
+        end = names[i + 1][1] if i + 1 < len(names) else order[-1] + 4
+        func_end[names[i][0]] = end
+
+
+def func_at(addr):
+    for name, a in funcs.items():
+        if a == addr:
+            return name
+    return None
+
+
+def next_addr(insn):
+    return insn.addr + insn.size * 2
+
+
+def in_func(addr, func):
+    return funcs[func] <= addr < func_end[func]
+
+
+# ----- Cycle counts ----------------------------------------------------------
+
+
+TWO = set(("adiw", "sbiw", "mul", "muls", "mulsu", "fmul", "fmuls", "fmulsu",
+    "ld", "ldd", "st", "std", "lds", "sts", "push", "pop", "cbi", "sbi",
+    "rjmp", "ijmp"))
+THREE = set(("jmp", "rcall", "icall", "lpm", "elpm"))
+FOUR = set(("call", "ret", "reti"))
+SKIPS = set(("cpse", "sbrc", "sbrs", "sbic", "sbis"))
+
+
+def cycles(insn):
+    if insn.op in FOUR:
+        return 4
+    if insn.op in THREE:
+        return 3
+    if insn.op in TWO:
+        return 2
+    return 1
+
+
+def is_branch(insn):
+    return insn.op.startswith("br") and insn.op != "break"
+
+
+# ----- Board-specific instructions -------------------------------------------
+
+
+def reg(s):
+    m = re.match(r"^r(\d+)$", s)
+    return int(m.group(1)) if m else None
+
+
+def accesses(insn, where):
+    space, addr = where
+    if space == "io":
+        if insn.op in ("out", "in"):
+            port = insn.args[0] if insn.op == "out" else insn.args[1]
+            if parse_int(port) == addr:
+                return True
+        addr += 0x20
+    if insn.op == "sts":
+        return parse_int(insn.args[0]) & 0xffff == addr
+    if insn.op == "lds":
+        return parse_int(insn.args[1]) & 0xffff == addr
+    return False
+
+
+def pin_op(insn, pin):
+    if insn.op not in ("sbi", "cbi"):
+        return False
+    return parse_int(insn.args[0]) == pin[0] and \
+        parse_int(insn.args[1]) == pin[1]
+
+
+def touches_spi(insn):
+    return (insn.op in ("sts", "out") and accesses(insn, board["data"])) or \
+        pin_op(insn, board["nss"]) or pin_op(insn, board["slp_tr"])
+
+
+# ----- Loops -----------------------------------------------------------------
+
+
+COUNTDOWN = set(("dec", "subi", "sbci", "sbiw", "nop"))
+
+poll_heads = {}		# loop head -> (one turn, last turn, exit address)
+count_heads = {}	# loop head -> (body cycles, counter registers, exit)
+
+
+def find_loops():
+    """
+    Recognize the loops we can time without a bound. We look at them from
+    their head, since the first pass through the body would otherwise look
+    like a way out.
+    """
+    for a in order:
+        insn = insns[a]
+        if insn.target is None or insn.target > insn.addr or \
+            not in_func(insn.target, insn.func) or \
+            insn.op in ("call", "rcall"):
+            continue
+        body = [insns[b] for b in order if insn.target <= b < insn.addr]
+        if not body:
+            continue
+        base = sum(cycles(i) for i in body)
+        if any(i.op in ("lds", "in") and accesses(i, board["status"])
+            for i in body) and not any(touches_spi(i) or
+            i.op in ("call", "rcall", "icall") for i in body):
+            poll_heads[insn.target] = (base + 2, base + 1, next_addr(insn))
+        elif insn.op == "brne" and all(i.op in COUNTDOWN for i in body):
+            counter = []
+            for i in body:
+                if i.op == "nop":
+                    continue
+                r = reg(i.args[0])
+                counter.append(r)
+                if i.op == "sbiw":
+                    counter.append(r + 1)
+            count_heads[insn.target] = (base, counter, next_addr(insn))
+
+
+def countdown_cycles(head, regs):
+    body, counter, _ = count_heads[head]
+    n = 0
+    for shift, r in enumerate(counter):
+        if regs.get(r) is None:
+            return None
+        n |= regs[r] << (8 * shift)
+    if n == 0:
+        n = 1 << (8 * len(counter))
+    return n * (body + 2) - 1
+
+
+# ----- Register constants ----------------------------------------------------
+
+
+CLOBBERED = list(range(18, 28)) + [30, 31, 0, 1]
+
+
+def track(insn, regs):
+    op, args = insn.op, insn.args
+    if op == "ldi":
+        regs[reg(args[0])] = parse_int(args[1]) & 0xff
+        return
+    if op == "ser":
+        regs[reg(args[0])] = 0xff
+        return
+    if op in ("clr", "eor") and (op == "clr" or args[0] == args[1]):
+        regs[reg(args[0])] = 0
+        return
+    if op == "mov":
+        regs[reg(args[0])] = regs.get(reg(args[1]))
+        return
+    if op == "movw":
+        d, s = reg(args[0]), reg(args[1])
+        regs[d], regs[d + 1] = regs.get(s), regs.get(s + 1)
+        return
+    if op in ("call", "rcall", "icall"):
+        for r in CLOBBERED:
+            regs[r] = None
+        return
+    if op in ("mul", "muls", "mulsu", "fmul", "fmuls", "fmulsu"):
+        regs[0] = regs[1] = None
+        return
+    if op in ("st", "std", "sts", "out", "push", "cp", "cpc", "cpi", "tst",
+        "cbi", "sbi") or op in SKIPS or not args:
+        return
+    r = reg(args[0])
+    if r is not None:
+        regs[r] = None
+        if op in ("adiw", "sbiw"):
+            regs[r + 1] = None
+
+
+# ----- Function summaries ----------------------------------------------------
+
+
+summaries = {}
+
+
+def summary(func):
+    """(fewest, most) cycles of func from its first instruction to RET"""
+    if func in summaries:
+        if summaries[func] is None:
+            fail("recursion through %s" % func)
+        return summaries[func]
+    summaries[func] = None
+    ex = Explorer(None, None)
+    ex.run(State(funcs[func], (), (), (0, 0), {}))
+    if not ex.ends:
+        fail("%s never returns" % func)
+    summaries[func] = (min(e[0] for e in ex.ends), max(e[1] for e in ex.ends))
+    return summaries[func]
+
+
+spi_funcs = {}
+
+
+def uses_spi(func):
+    """whether func or anything it calls touches SPI, nSS, or SLP_TR"""
+    if func in spi_funcs:
+        return spi_funcs[func]
+    spi_funcs[func] = False
+    res = False
+    for a in order:
+        i = insns[a]
+        if i.func != func:
+            continue
+        if touches_spi(i):
+            res = True
+        elif i.op in ("call", "rcall", "jmp", "rjmp") and \
+            i.target is not None and not in_func(i.target, func) and \
+            func_at(i.target) and uses_spi(func_at(i.target)):
+            res = True
+    spi_funcs[func] = res
+    return res
+
+
+# ----- Exploration -----------------------------------------------------------
+
+
+class State:
+    def __init__(self, pc, stack, loops, t, regs, w = None, nss = False,
+        idx = None, buf = False, last = -1):
+        self.pc = pc
+        self.stack = stack      # (return address, callee), innermost last
+        self.loops = loops      # ((back edge, turns), ...)
+        self.t = t              # (fewest, most) cycles since the IRQ edge
+        self.w = w              # same, of the last SPI write
+        self.regs = regs        # register -> constant or None
+        self.nss = nss          # nSS is low
+        self.idx = idx          # bytes after the command, None before it
+        self.buf = buf          # the transfer is a BUF_READ
+        self.last = last        # highest PSDU byte read
+
+    def key(self):
+        return (self.pc, self.stack, self.loops, self.nss, self.idx,
+            self.buf, self.last)
+
+    def copy(self, **kw):
+        s = State(self.pc, self.stack, self.loops, self.t, dict(self.regs),
+            self.w, self.nss, self.idx, self.buf, self.last)
+        for k, v in kw.items():
+            setattr(s, k, v)
+        return s
+
+    def merge(self, o):
+        changed = False
+        t = (min(self.t[0], o.t[0]), max(self.t[1], o.t[1]))
+        if t != self.t:
+            self.t, changed = t, True
+        if o.w is not None:
+            w = o.w if self.w is None else \
+                (min(self.w[0], o.w[0]), max(self.w[1], o.w[1]))
+            if w != self.w:
+                self.w, changed = w, True
+        for r in list(self.regs):
+            if self.regs[r] is not None and self.regs[r] != o.regs.get(r):
+                self.regs[r], changed = None, True
+        return changed
+
+
+def add(t, lo, hi = None):
+    return (t[0] + lo, t[1] + (lo if hi is None else hi))
+
+
+def widen(old, t):
+    return t if old is None else (min(old[0], t[0]), max(old[1], t[1]))
+
+
+class Explorer:
+    """
+    With a target, we go from an interrupt vector to it, following only code
+    that can still get there ("allowed", per function on the way), and check
+    the SPI timing once inside. Without one, we just collect the times at
+    which the function returns.
+    """
+
+    def __init__(self, allowed, target):
+        self.allowed = allowed
+        self.target = target
+        self.ends = []
+        self.reads = {}         # (insn, byte) -> (fewest, most) cycles
+        self.decisions = {}     # insn -> ((fewest, most), last byte read)
+        self.returns = {}       # insn -> (fewest, most)
+
+    def run(self, start):
+        seen = { start.key(): start }
+        queue = [(0, 0, start.key())]
+        serial = 0
+        while queue:
+            _, _, key = heapq.heappop(queue)
+            for n in self.step(seen[key].copy()):
+                k = n.key()
+                if k in seen:
+                    if not seen[k].merge(n):
+                        continue
+                else:
+                    seen[k] = n
+                serial += 1
+                heapq.heappush(queue, (n.t[0], serial, k))
+
+    def inside(self, s):
+        return self.target is not None and \
+            any(f == funcs[self.target] for _, f in s.stack)
+
+    def step(self, s):
+        insn = insns.get(s.pc)
+        if insn is None:
+            fail("no instruction at 0x%x" % s.pc)
+        inside = self.inside(s)
+        c = cycles(insn)
+        nxt = next_addr(insn)
+
+        if self.target is not None and not inside and \
+            s.pc not in self.allowed.get(insn.func, ()):
+            return []
+
+        if s.pc in poll_heads:
+            return self.poll(s)
+        if s.pc in count_heads:
+            n = countdown_cycles(s.pc, s.regs)
+            if n is not None:
+                ns = s.copy(pc = count_heads[s.pc][2], t = add(s.t, n))
+                for r in count_heads[s.pc][1]:
+                    ns.regs[r] = 0
+                return [ns]
+
+        if insn.op in ("ret", "reti"):
+            if not s.stack:
+                self.ends.append(add(s.t, c))
+                return []
+            ret, callee = s.stack[-1]
+            if self.target is not None and callee == funcs[self.target]:
+                self.returns[insn] = widen(self.returns.get(insn),
+                    add(s.t, c))
+                return []
+            return [s.copy(pc = ret, stack = s.stack[:-1], t = add(s.t, c),
+                loops = self.pop_loops(s.loops, callee))]
+
+        if insn.op in ("icall", "ijmp", "eicall", "eijmp"):
+            if inside or self.target is None:
+                fail("%s: indirect %s" % (insn,
+                    "call" if "call" in insn.op else "jump"))
+            return []
+
+        r = self.spi(insn, s, inside)
+        if r is not None:
+            return r
+
+        if insn.op in ("call", "rcall"):
+            callee = func_at(insn.target)
+            if callee is None:
+                fail("%s: call into the middle of a function" % insn)
+            if self.target is not None and (callee == self.target or
+                (not inside and callee in self.allowed) or
+                (inside and uses_spi(callee))):
+                return [s.copy(pc = insn.target, t = add(s.t, c),
+                    stack = s.stack + ((nxt, insn.target),))]
+            lo, hi = summary(callee)
+            track(insn, s.regs)
+            return [s.copy(pc = nxt, t = add(s.t, c + lo, c + hi))]
+
+        track(insn, s.regs)
+
+        if insn.op in SKIPS:
+            skipped = insns.get(nxt)
+            if skipped is None:
+                fail("%s: nothing to skip" % insn)
+            skip = 2 if skipped.size == 1 else 3
+            return [s.copy(pc = nxt, t = add(s.t, 1)),
+                s.copy(pc = next_addr(skipped), t = add(s.t, skip))]
+
+        if insn.op in ("rjmp", "jmp") or is_branch(insn):
+            if insn.target is None:
+                fail("%s: no target" % insn)
+            res = []
+            taken = 2 if is_branch(insn) else c
+            if is_branch(insn):
+                res.append(s.copy(pc = nxt, t = add(s.t, 1)))
+            if not in_func(insn.target, insn.func):
+                # tail call
+                stack = s.stack
+                if self.target is not None and \
+                    insn.target == funcs[self.target] and not inside:
+                    stack = stack + ((None, insn.target),)
+                return res + [s.copy(pc = insn.target, stack = stack,
+                    t = add(s.t, taken))]
+            if insn.target <= insn.addr:
+                return res + self.back(insn, s, taken)
+            return res + [s.copy(pc = insn.target, t = add(s.t, taken))]
+
+        return [s.copy(pc = nxt, t = add(s.t, c))]
+
+    def poll(self, s):
+        turn, last, exit = poll_heads[s.pc]
+        done = add(s.w or (0, 0), board["spi_cycles"])
+        lo = max(s.t[0], done[0] - turn) + last
+        hi = (s.t[1] if s.t[1] >= done[1] else done[1] + turn) + last
+        return [s.copy(pc = exit, t = (lo, hi))]
+
+    def spi(self, insn, s, inside):
+        c = cycles(insn)
+        if pin_op(insn, board["nss"]):
+            return [s.copy(pc = next_addr(insn), t = add(s.t, c),
+                nss = insn.op == "cbi", idx = None, buf = False)]
+        if pin_op(insn, board["slp_tr"]) and insn.op == "sbi" and inside:
+            t = add(s.t, c)
+            old = self.decisions.get(insn)
+            if old:
+                self.decisions[insn] = (widen(old[0], t), min(old[1], s.last))
+            else:
+                self.decisions[insn] = (t, s.last)
+            return []
+        if not (insn.op in ("sts", "out") and accesses(insn, board["data"])):
+            return None
+        n = s.copy(pc = next_addr(insn), t = add(s.t, c), w = add(s.t, c))
+        if not s.nss:
+            return [n]
+        if s.idx is None:
+            n.idx, n.buf = 0, \
+                s.regs.get(reg(insn.args[-1])) == BUF_READ
+            return [n]
+        n.idx = s.idx + 1
+        if s.buf and inside:
+            byte = s.idx - 1            # -1 is the PHR
+            self.reads[(insn, byte)] = \
+                widen(self.reads.get((insn, byte)), n.w)
+            n.last = max(s.last, byte)
+        return [n]
+
+    def back(self, insn, s, taken):
+        bound = bounds.get(insn.func)
+        if bound is None:
+            fail("%s: loop without bound (use -l %s=N)" % (insn, insn.func))
+        loops = dict(s.loops)
+        turns = loops.get(insn.addr, 1) + 1
+        if turns > bound:
+            return []
+        # going around an outer loop starts the inner ones afresh
+        for a in list(loops):
+            if insn.target <= a < insn.addr:
+                del loops[a]
+        loops[insn.addr] = turns
+        return [s.copy(pc = insn.target, t = add(s.t, taken),
+            loops = tuple(sorted(loops.items())))]
+
+    def pop_loops(self, loops, callee):
+        func = func_at(callee)
+        return tuple((a, n) for a, n in loops if not in_func(a, func))
+
+
+# ----- Call chain ------------------------------------------------------------
+
+
+def callees(func):
+    res = set()
+    for a in order:
+        i = insns[a]
+        if i.func == func and i.op in ("call", "rcall", "jmp", "rjmp") and \
+            i.target is not None:
+            f = func_at(i.target)
+            if f and f != func:
+                res.add(f)
+    return res
+
+
+def find_chain(start, target):
+    prev = { start: None }
+    todo = [start]
+    while todo:
+        f = todo.pop(0)
+        if f == target:
+            path = []
+            while f:
+                path.insert(0, f)
+                f = prev[f]
+            return path
+        for c in sorted(callees(f)):
+            if c not in prev:
+                prev[c] = f
+                todo.append(c)
+    return None
+
+
+def reaching(func, callee):
+    """addresses in func from which a call to callee can be reached"""
+    succ = {}
+    for a in order:
+        i = insns[a]
+        if i.func != func:
+            continue
+        n = []
+        if i.op not in ("ret", "reti", "rjmp", "jmp", "ijmp"):
+            n.append(next_addr(i))
+        if i.op in SKIPS and insns.get(next_addr(i)):
+            n.append(next_addr(insns[next_addr(i)]))
+        if i.target is not None and i.op not in ("call", "rcall"):
+            n.append(i.target)
+        succ[a] = n
+    good = set(a for a in succ if
+        insns[a].op in ("call", "rcall", "jmp", "rjmp") and
+        func_at(insns[a].target) == callee)
+    changed = True
+    while changed:
+        changed = False
+        for a, n in succ.items():
+            if a not in good and any(x in good for x in n):
+                good.add(a)
+                changed = True
+    return good
+
+
+def prologue(func):
+    a, c, pushes = funcs[func], 0, 0
+    while a in insns and insns[a].op in ("push", "in", "eor", "clr"):
+        c += cycles(insns[a])
+        pushes += insns[a].op == "push"
+        a = next_addr(insns[a])
+    return c, pushes
+
+
+# ----- Report ----------------------------------------------------------------
+
+
+def us(c):
+    return c / mhz
+
+
+def span(t):
+    if t[0] == t[1]:
+        return "%.1f us" % us(t[0])
+    return "%.1f-%.1f us" % (us(t[0]), us(t[1]))
+
+
+def fail(msg):
+    print("%s: %s" % (sys.argv[0], msg), file = sys.stderr)
+    sys.exit(2)
+
+
+def analyze(vector, target):
+    chain = find_chain(vector, target)
+    allowed = {}
+    for f, nxt in zip(chain, chain[1:]):
+        allowed[f] = reaching(f, nxt)
+    ex = Explorer(allowed, target)
+    ex.run(State(funcs[vector], (), (), (IRQ_RESPONSE, IRQ_RESPONSE_MAX),
+        {}))
+
+    c, pushes = prologue(vector)
+    print("%s -> %s" % (vector, " -> ".join(chain[1:])))
+    print("  prologue: %d cycles, %d pushes" % (c, pushes))
+    phr = [t for (_, byte), t in ex.reads.items() if byte < 0]
+    if phr:
+        print("  PHR read at %s after the IRQ edge" %
+            span((min(t[0] for t in phr), max(t[1] for t in phr))))
+
+    errors = 0
+    behind = 0
+    for (insn, byte), t in sorted(ex.reads.items(),
+        key = lambda x: (x[0][1], x[0][0].addr)):
+        if byte < 0:
+            continue
+        arrival = (byte + 1) * byte_cycles
+        if t[0] < arrival:
+            print("  %s: PSDU[%d] read at %s, before it arrives at %s" %
+                (insn, byte, span(t), span((arrival, arrival))))
+            errors += 1
+        behind = max(behind, t[1] - arrival)
+    if ex.reads:
+        print("  reads: PSDU up to [%d], at most %.1f us behind the air" %
+            (max(b for _, b in ex.reads), us(max(behind, 0))))
+
+    for insn, (t, last) in sorted(ex.decisions.items(),
+        key = lambda x: x[0].addr):
+        end = (last + 1 + FCS) * byte_cycles
+        if budget is not None:
+            end = min(end, budget * mhz)
+        on_air = t[1] + tx_delay * mhz
+        ok = on_air <= end
+        print("  %s: SLP_TR at %s, on air by %.1f us, frame over at %.1f us%s"
+            % (insn, span(t), us(on_air), us(end), "" if ok else "  LATE"))
+        errors += not ok
+    for insn, t in sorted(ex.returns.items(), key = lambda x: x[0].addr):
+        print("  %s: returns at %s" % (insn, span(t)))
+    return errors
+
+
+def usage():
+    print("usage: %s [-b board] [-r kbps] [-f MHz] [-t us] [-d us]\n"
+        "       %s [-l function=iterations ...] [objdump-output|elf]\n\n"
+        "  -b board    atusb, rzusb, or hulusb (default: atusb)\n"
+        "  -r kbps     PHY data rate (default: 250)\n"
+        "  -f MHz      CPU clock (default: 8)\n"
+        "  -t us       from SLP_TR to the first bit on the air (default: 16)\n"
+        "  -d us       also require SLP_TR within this time of the IRQ\n"
+        "  -l f=N      bound for loops in function f\n\n"
+        "Exit status 1 if a timing requirement isn't met, 2 if the code can't\n"
+        "be analyzed." % (sys.argv[0], " " * len(sys.argv[0])),
+        file = sys.stderr)
+    sys.exit(2)
+
+
+board_name = "atusb"
+rate = 250
+mhz = 8
+tx_delay = 16
+budget = None
+bounds = {}
+
+try:
+    opts, args = getopt.getopt(sys.argv[1:], "b:d:f:l:r:t:")
+except getopt.GetoptError:
+    usage()
+for opt, arg in opts:
+    if opt == "-b":
+        board_name = arg
+    elif opt == "-d":
+        budget = float(arg)
+    elif opt == "-f":
+        mhz = float(arg)
+    elif opt == "-l":
+        f, n = arg.split("=")
+        bounds[f] = int(n)
+    elif opt == "-r":
+        rate = float(arg)
+    elif opt == "-t":
+        tx_delay = float(arg)
+if len(args) > 1 or board_name not in BOARDS:
+    usage()
+
+board = BOARDS[board_name]
+byte_cycles = 8 / rate * 1000 * mhz
+
+if not args:
+    disassemble(sys.stdin)
+elif args[0].endswith(".elf"):
+    out = subprocess.run(["avr-objdump", "-d", args[0]],
+        stdout = subprocess.PIPE, universal_newlines = True, check = True)
+    disassemble(out.stdout.splitlines())
+else:
+    with open(args[0]) as f:
+        disassemble(f)
+
+find_loops()
+
+if "attack" not in funcs:
+    fail("no attack() in the disassembly")
+vectors = [f for f in funcs if f.startswith("__vector_") and
+    find_chain(f, "attack")]
+if not vectors:
+    fail("no interrupt vector leads to attack()")
+
+errors = 0
+for v in sorted(vectors):
+    errors += analyze(v, "attack")
+sys.exit(1 if errors else 0)
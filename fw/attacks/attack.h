@@ -15,4 +15,47 @@
 
 bool attack(void);
 
+#ifndef SHADOW
+
+/*
+ * Set by slp_tr_more() for a transmission that the attack continues on a
+ * timer. mac_irq drops the one TRX_END it causes, so that only the
+ * sequence's last frame reaches the capture path.
+ */
+extern bool attack_tx_more;
+
+#endif
+
+#if defined(SHADOW) && defined(ATTACK_CODE)
+
+/*
+ * Decide-only build: the attack reads the frame as usual, but shadow.c drops
+ * whatever it would do to the transceiver and reports its decision instead.
+ */
+
+#include "shadow.h"
+
+#define	spi_begin()		shadow_spi_begin()
+#define	spi_io(v)		shadow_spi_io(v)
+#define	spi_end()		shadow_spi_end(__LINE__)
+#define	reg_write(reg, value)	shadow_reg_write(reg, value)
+#define	change_state(new)	shadow_change_state(new)
+#define	slp_tr()		shadow_slp_tr()
+#define	slp_tr_more()		shadow_slp_tr()
+
+#elif defined(ATTACK_CODE)
+
+/* attacks read frames as they arrive, so they use the inline accessors */
+
+#include "hal.h"
+
+#define	spi_begin()		hal_spi_begin()
+#define	spi_io(v)		hal_spi_io(v)
+#define	spi_end()		hal_spi_end()
+#define	reg_read(reg)		hal_reg_read(reg)
+#define	slp_tr()		hal_slp_tr()
+#define	slp_tr_more()		(attack_tx_more = 1, hal_slp_tr())
+
+#endif /* ATTACK_CODE */
+
 #endif /* !ATTACK_H */
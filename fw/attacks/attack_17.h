@@ -1,18 +0,0 @@
-/*
- * fw/attacks/attack_17.h - Declaration of the attack_17 functions
- *
- * Written 2022 by Dimitrios-Georgios Akestoridis
- * Copyright 2022 Dimitrios-Georgios Akestoridis
- *
- * This program is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation; either version 2 of the License, or
- * (at your option) any later version.
- */
-
-#ifndef ATTACK_17_H
-#define	ATTACK_17_H
-
-void start_timer(void);
-
-#endif /* !ATTACK_17_H */
@@ -20,6 +20,10 @@
 #include "spi.h"
 #include "board.h"
 #include "attack.h"
+#include "decode.h"
+
+
+static struct decode d;
 
 
 /*
@@ -162,82 +166,29 @@ bool attack(void)
 	_delay_us(32);
 	mac_src_7 = spi_recv();
 
-	/* Make sure that it is a 6LoWPAN first fragment */
-	_delay_us(32);
-	if ((spi_recv() & 0xf8) != 0xc0) {
-		/* Ignore packets with unexpected 6LoWPAN pattern values */
-		spi_end();
-		return 1;
-	}
-
-	/* Ignore the datagram size */
-	_delay_us(32);
-	spi_recv();
-
-	/* Ignore the datagram tag */
-	_delay_us(32);
-	spi_recv();
-	_delay_us(32);
-	spi_recv();
+	/* Decode the 6LoWPAN headers up to the UDP ports */
+	decode_start(&d, DECODE_LOWPAN);
+	do {
+		_delay_us(32);
+		decode_byte(&d, spi_recv());
+		if (decode_not_frag1_udp(&d)) {
+			/* Ignore packets with unexpected header field values */
+			spi_end();
+			return 1;
+		}
+	} while (!(d.have & (DECODE_UDP | DECODE_END)));
 
-	/* Check the IPHC header */
-	_delay_us(32);
-	rx_byte = spi_recv();
-	if (rx_byte != 0x7f && rx_byte != 0x7e && rx_byte != 0x7d) {
-		/* Ignore packets with unexpected IPHC field values */
-		spi_end();
-		return 1;
-	}
-	_delay_us(32);
-	if (spi_recv() != 0x33) {
-		/* Ignore packets with unexpected IPHC field values */
+	/* Ignore packets that end before the UDP ports */
+	if (!(d.have & DECODE_UDP)) {
 		spi_end();
 		return 1;
 	}
 
-	/* Check the NHC UDP header */
-	_delay_us(32);
-	if (spi_recv() != 0xf0) {
-		/* Ignore packets with unexpected NHC UDP field values */
-		spi_end();
-		return 1;
-	}
-
-	/* Check the source port */
-	_delay_us(32);
-	if (spi_recv() != ((UDPSRCPORT >> 8) & 0xff)) {
-		/*
-		 * Ignore packets that originated
-		 * from a different port
-		 */
-		spi_end();
-		return 1;
-	}
-	_delay_us(32);
-	if (spi_recv() != (UDPSRCPORT & 0xff)) {
+	/* Check the source and destination ports */
+	if (d.udp_src != UDPSRCPORT || d.udp_dst != UDPDSTPORT) {
 		/*
-		 * Ignore packets that originated
-		 * from a different port
-		 */
-		spi_end();
-		return 1;
-	}
-
-	/* Check the destination port */
-	_delay_us(32);
-	if (spi_recv() != ((UDPDSTPORT >> 8) & 0xff)) {
-		/*
-		 * Ignore packets that are
-		 * destined for a different port
-		 */
-		spi_end();
-		return 1;
-	}
-	_delay_us(32);
-	if (spi_recv() != (UDPDSTPORT & 0xff)) {
-		/*
-		 * Ignore packets that are
-		 * destined for a different port
+		 * Ignore packets that are not exchanged
+		 * between the specified ports
 		 */
 		spi_end();
 		return 1;
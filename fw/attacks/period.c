@@ -0,0 +1,140 @@
+/*
+ * fw/attacks/period.c - Active and idle periods of the periodic attacks
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * An idle period of IDLESEC seconds is followed by a wait period, which
+ * lasts until the attack finds its first target. The active period then
+ * lasts ACTIVESEC seconds, or until IDLESEC seconds pass without a target,
+ * in which case we go back to waiting. Seconds are counted by a periodic
+ * timer, which is restarted whenever the count is reset.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "timer.h"
+#include "period.h"
+
+
+static uint32_t active, idle;
+static bool idle_period = 1;
+static bool wait_period = 0;
+static uint32_t elapsed_seconds = 0;
+static uint32_t last_activity = 0;
+static struct timer tick;
+
+
+static void second(void *user)
+{
+	/* Update the elapsed seconds counter */
+	elapsed_seconds++;
+
+	/* Check for potential period transitions */
+	if (idle_period) {
+		/* Determine whether the idle period ended or not */
+		if (elapsed_seconds >= idle) {
+			/* Reset the elapsed seconds counter */
+			elapsed_seconds = 0;
+
+			/* Indicate that the wait period began */
+			idle_period = 0;
+			wait_period = 1;
+		}
+	} else if (!wait_period) {
+		/* Determine whether the active period ended or not */
+		if (elapsed_seconds - last_activity > idle) {
+			/* Reset the elapsed seconds counter */
+			elapsed_seconds = 0;
+
+			/* Restart the wait period */
+			wait_period = 1;
+		} else if (elapsed_seconds >= active) {
+			/* Reset the elapsed seconds counter */
+			elapsed_seconds = 0;
+
+			/* Check the duration of the idle period */
+			if (idle > 0) {
+				/* Indicate that the idle period began */
+				idle_period = 1;
+				wait_period = 0;
+			}
+		}
+	}
+}
+
+
+/* Reset the elapsed seconds counter, including the current fraction */
+
+static void restart(void)
+{
+	elapsed_seconds = 0;
+	timer_start(&tick, TIMER_MS(1000), TIMER_MS(1000), second, NULL);
+}
+
+
+void period_start(uint32_t active_sec, uint32_t idle_sec)
+{
+	active = active_sec;
+	idle = idle_sec;
+	restart();
+}
+
+
+bool period_proceed(void)
+{
+	/* Determine whether to proceed or not */
+	if (idle_period) {
+		/* Do not proceed during an idle period */
+		return 0;
+	} else if (wait_period) {
+		/* Reset the elapsed seconds counter */
+		restart();
+
+		/* Reset the relative time of the last activity */
+		last_activity = 0;
+
+		/* Check the duration of the active period */
+		if (active > 0) {
+			/* Indicate that the active period began */
+			wait_period = 0;
+		} else {
+			/* Do not proceed if there is no active period */
+			return 0;
+		}
+	}
+
+	/* Check whether a period of inactivity passed or not */
+	if (elapsed_seconds - last_activity > idle) {
+		/* Restart the active period */
+		restart();
+		last_activity = 0;
+	} else {
+		/* Update the relative time of the last activity */
+		last_activity = elapsed_seconds;
+	}
+	return 1;
+}
+
+
+void period_idle(void)
+{
+	/* Reset the elapsed seconds counter */
+	restart();
+
+	/* Check the duration of the idle period */
+	if (idle > 0) {
+		/* Indicate that the idle period began */
+		idle_period = 1;
+		wait_period = 0;
+	}
+}
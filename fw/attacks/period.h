@@ -0,0 +1,29 @@
+/*
+ * fw/attacks/period.h - Active and idle periods of the periodic attacks
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PERIOD_H
+#define	PERIOD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* start counting seconds, beginning with an idle period */
+void period_start(uint32_t active_sec, uint32_t idle_sec);
+
+/* whether the attack may act on a target now, which counts as activity */
+bool period_proceed(void);
+
+/* start over with an idle period, if there is one */
+void period_idle(void);
+
+#endif /* !PERIOD_H */
@@ -48,9 +48,8 @@ int main(void)
 
 	usb_init();
 	ep0_init();
-#ifdef ATUSB
 	timer_init();
-
+#ifdef ATUSB
 	/* move interrupt vectors to 0 */
 	MCUCR = 1 << IVCE;
 	MCUCR = 0;
@@ -0,0 +1,287 @@
+/*
+ * fw/bench.c - Micro-benchmarks of SPI and transceiver access (ATUSB_BENCH)
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Timer 1 runs at the CPU clock, so its ticks are cycles, and nothing
+ * interrupts us since we run from the USB interrupt. Each run only times
+ * the primitive itself. Setting up the frame buffer for a read, and reading
+ * back what a write left there, happen outside the timed part. The data
+ * changes from run to run, so a check can't pass on what an earlier run
+ * left behind.
+ *
+ * The transceiver's interrupts are masked while we run, as in
+ * chan_calibrate, so the end of a transmission doesn't reach the HardMAC.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "at86rf230.h"
+#include "spi.h"
+#include "board.h"
+#include "timer.h"
+#include "atusb/atusb.h"
+#include "mac.h"
+#ifdef TEMPLATE
+#include "template.h"
+#endif
+#include "bench.h"
+
+
+#define	RUNS		ATUSB_BENCH_RUNS
+#define	STATE_TIMEOUT	TIMER_US(1000)	/* TRX_OFF to PLL_ON takes 110 us */
+#define	TX_TIMEOUT	TIMER_MS(6)	/* aMaxPHYPacketSize is 4.3 ms */
+
+
+static uint8_t data[SRAM_SIZE];
+static uint16_t errors;
+
+
+/* ----- Helpers ----------------------------------------------------------- */
+
+
+static uint8_t pattern(uint8_t i, uint8_t run)
+{
+	return i*29+run*7+1;
+}
+
+
+static bool wait_status(uint8_t status, uint16_t timeout)
+{
+	uint16_t t0 = TCNT1;
+
+	while ((reg_read(REG_TRX_STATUS) & TRX_STATUS_MASK) != status)
+		if ((uint16_t) (TCNT1-t0) > timeout)
+			return 0;
+	return 1;
+}
+
+
+static void buf_write(uint8_t run, uint8_t n)
+{
+	uint8_t i;
+
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(n);
+	for (i = 0; i != n; i++)
+		spi_send(pattern(i, run));
+	spi_end();
+}
+
+
+static uint8_t buf_read(uint8_t n)
+{
+	uint8_t phr;
+
+	spi_begin();
+	spi_send(AT86RF230_BUF_READ);
+	phr = spi_recv();
+	spi_recv_block(data, n);
+	spi_end();
+	return phr;
+}
+
+
+static void check(uint8_t run, uint8_t n, uint8_t phr)
+{
+	uint8_t i;
+
+	if (phr != n) {
+		errors++;
+		return;
+	}
+	for (i = 0; i != n; i++)
+		if (data[i] != pattern(i, run)) {
+			errors++;
+			return;
+		}
+}
+
+
+static void sram_fill(void)
+{
+	uint8_t i;
+
+	spi_begin();
+	spi_send(AT86RF230_SRAM_WRITE);
+	spi_send(0);
+	for (i = 0; i != SRAM_SIZE; i++)
+		spi_send(pattern(i, 0));
+	spi_end();
+}
+
+
+/* ----- Primitives -------------------------------------------------------- */
+
+
+static uint16_t measure(uint8_t id, uint8_t run, uint8_t n)
+{
+	static uint8_t addr = 0;
+	uint16_t t0, t;
+	uint8_t phr = 0, v = 0;
+	bool ok = 1;
+
+	switch (id) {
+	case ATUSB_BENCH_BUF_READ:
+	case ATUSB_BENCH_SLP_TR:
+		buf_write(run, n);
+		break;
+	case ATUSB_BENCH_SRAM_READ:
+		addr = (addr*109+89) & (SRAM_SIZE-1);
+		break;
+	default:
+		break;
+	}
+
+	t0 = TCNT1;
+	switch (id) {
+	case ATUSB_BENCH_NONE:
+		break;
+	case ATUSB_BENCH_SPI_IO:
+		spi_io(run);
+		break;
+	case ATUSB_BENCH_SPI_BLOCK:
+		spi_recv_block(data, n);
+		break;
+	case ATUSB_BENCH_REG_READ:
+		v = reg_read(REG_TRX_STATUS);
+		break;
+	case ATUSB_BENCH_STATE:
+		change_state(TRX_CMD_RX_ON);
+		ok = wait_status(TRX_STATUS_RX_ON, STATE_TIMEOUT);
+		change_state(TRX_CMD_PLL_ON);
+		ok = wait_status(TRX_STATUS_PLL_ON, STATE_TIMEOUT) && ok;
+		break;
+	case ATUSB_BENCH_BUF_WRITE:
+		buf_write(run, n);
+		break;
+	case ATUSB_BENCH_BUF_READ:
+		phr = buf_read(n);
+		break;
+	case ATUSB_BENCH_SRAM_READ:
+		spi_begin();
+		spi_send(AT86RF230_SRAM_READ);
+		spi_send(addr);
+		v = spi_recv();
+		spi_end();
+		break;
+	case ATUSB_BENCH_SLP_TR:
+		slp_tr();
+		ok = wait_status(TRX_STATUS_BUSY_TX, STATE_TIMEOUT);
+		break;
+	}
+	t = TCNT1-t0;
+
+	switch (id) {
+	case ATUSB_BENCH_REG_READ:
+		ok = (v & TRX_STATUS_MASK) == TRX_STATUS_PLL_ON;
+		break;
+	case ATUSB_BENCH_BUF_WRITE:
+		check(run, n, buf_read(n));
+		break;
+	case ATUSB_BENCH_BUF_READ:
+		check(run, n, phr);
+		break;
+	case ATUSB_BENCH_SRAM_READ:
+		ok = v == pattern(addr, 0);
+		break;
+	case ATUSB_BENCH_SLP_TR:
+		ok = wait_status(TRX_STATUS_PLL_ON, TX_TIMEOUT) && ok;
+		break;
+	default:
+		break;
+	}
+	if (!ok)
+		errors++;
+	return t;
+}
+
+
+static bool takes_bytes(uint8_t id)
+{
+	switch (id) {
+	case ATUSB_BENCH_SPI_BLOCK:
+	case ATUSB_BENCH_BUF_WRITE:
+	case ATUSB_BENCH_BUF_READ:
+	case ATUSB_BENCH_SLP_TR:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+
+/* ----- Runs -------------------------------------------------------------- */
+
+
+static void put16(uint8_t *buf, uint16_t v)
+{
+	buf[0] = v;
+	buf[1] = v >> 8;
+}
+
+
+uint8_t bench_run(uint16_t id, uint16_t bytes, uint8_t *buf)
+{
+	uint16_t overhead = 0xffff, min = 0xffff, max = 0;
+	uint32_t sum = 0;
+	uint16_t t;
+	uint8_t irq_mask, run;
+
+	if (id >= ATUSB_BENCH_PRIMITIVES)
+		return 0;
+	if (takes_bytes(id) ? !bytes || bytes > MAX_PSDU : bytes)
+		return 0;
+
+	mac_rx(0);
+	irq_mask = reg_read(REG_IRQ_MASK);
+	reg_write(REG_IRQ_MASK, 0);
+#ifdef TEMPLATE
+	template_forget();
+#endif
+	change_state(TRX_CMD_PLL_ON);
+	errors = !wait_status(TRX_STATUS_PLL_ON, STATE_TIMEOUT);
+
+	for (run = 0; run != RUNS; run++) {
+		t = measure(ATUSB_BENCH_NONE, run, 0);
+		if (t < overhead)
+			overhead = t;
+	}
+	if (id == ATUSB_BENCH_NONE)
+		overhead = 0;
+	if (id == ATUSB_BENCH_SRAM_READ)
+		sram_fill();
+
+	for (run = 0; run != RUNS; run++) {
+		t = measure(id, run, bytes);
+		t = t > overhead ? t-overhead : 0;
+		if (t < min)
+			min = t;
+		if (t > max)
+			max = t;
+		sum += t;
+	}
+
+	change_state(TRX_CMD_FORCE_TRX_OFF);
+	reg_read(REG_IRQ_STATUS);
+	reg_write(REG_IRQ_MASK, irq_mask);
+	clear_irq();
+
+	put16(buf, min);
+	put16(buf+2, sum/RUNS);
+	put16(buf+4, max);
+	put16(buf+6, errors);
+	return ATUSB_BENCH_REC_SIZE;
+}
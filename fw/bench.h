@@ -0,0 +1,26 @@
+/*
+ * fw/bench.h - Micro-benchmarks of SPI and transceiver access (ATUSB_BENCH)
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef BENCH_H
+#define	BENCH_H
+
+#include <stdint.h>
+
+
+/*
+ * Time primitive "id" of enum atusb_bench, with "bytes" where it takes them,
+ * and store the ATUSB_BENCH record in buf. Returns the record size, or 0 if
+ * the arguments are invalid.
+ */
+uint8_t bench_run(uint16_t id, uint16_t bytes, uint8_t *buf);
+
+#endif /* !BENCH_H */
@@ -25,6 +25,7 @@
 #include "at86rf230.h"
 #include "board.h"
 #include "spi.h"
+#include "hal.h"
 
 
 uint8_t board_sernum[42] = { 42, USB_DT_STRING };
@@ -41,14 +42,7 @@ void change_state(uint8_t new)
 
 uint8_t reg_read(uint8_t reg)
 {
-	uint8_t value;
-
-	spi_begin();
-	spi_send(AT86RF230_REG_READ | reg);
-	value = spi_recv();
-	spi_end();
-
-	return value;
+	return hal_reg_read(reg);
 }
 
 
@@ -16,6 +16,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include <avr/io.h>
+
 #include <atusb/atusb.h>
 
 #ifdef ATUSB
@@ -53,13 +55,24 @@
 #define	DFU_USB_VENDOR	USB_VENDOR
 #define	DFU_USB_PRODUCT	USB_PRODUCT
 
+#define	DFU_TRANSFER_SIZE	SPM_PAGESIZE	/* one flash page per block */
+
+/*
+ * The application leaves BOOT_MARKER at the beginning of SRAM when it resets
+ * the CPU for any reason but DFU, and the boot loader then starts it again
+ * right away. See reset_cpu() and boot.c.
+ */
+
+#define	BOOT_MARKER_ADDR	((volatile uint16_t *) RAMSTART)
+#define	BOOT_MARKER		0xb007
+
 
 #define	BOARD_MAX_mA	40
 
 #ifdef BOOT_LOADER
 #define	NUM_EPS	1
 #else
-#define	NUM_EPS	2
+#define	NUM_EPS	3	/* EP0, frames on EP1, telemetry on EP2 */
 #endif
 
 #define	HAS_BOARD_SERNUM
@@ -70,7 +83,9 @@ extern uint8_t irq_serial;
 
 void reset_rf(void);
 void reset_cpu(void);
+void reset_dfu(void);
 uint8_t read_irq(void);
+void clear_irq(void);
 void slp_tr(void);
 
 void led(bool on);
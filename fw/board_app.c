@@ -24,6 +24,7 @@
 #include "usb.h"
 #include "at86rf230.h"
 #include "spi.h"
+#include "hal.h"
 #include "mac.h"
 #include "board.h"
 
@@ -31,7 +32,27 @@
 static volatile uint32_t timer_h = 0;	/* 2^(16+32) / 8 MHz = ~1.1 years */
 
 
+/*
+ * The marker shares its location with whatever variable the linker put
+ * there, so we only write it once nothing else can run anymore: the
+ * watchdog first raises an interrupt, and resets the CPU on the next
+ * timeout.
+ */
+
+ISR(WDT_vect)
+{
+	*BOOT_MARKER_ADDR = BOOT_MARKER;
+	while (1);
+}
+
+
 void reset_cpu(void)
+{
+	WDTCSR = 1 << WDIE | 1 << WDE;
+}
+
+
+void reset_dfu(void)
 {
 	WDTCSR = 1 << WDE;
 }
@@ -43,10 +64,25 @@ uint8_t read_irq(void)
 }
 
 
+/*
+ * Forget an edge on the interrupt line that we have already dealt with by
+ * polling, so that it doesn't reach the interrupt handler.
+ */
+
+void clear_irq(void)
+{
+#if defined(ATUSB) || defined(HULUSB)
+	EIFR = 1 << INTF0;
+#endif
+#ifdef RZUSB
+	TIFR1 = 1 << ICF1;
+#endif
+}
+
+
 void slp_tr(void)
 {
-	SET(SLP_TR);
-	CLR(SLP_TR);
+	hal_slp_tr();
 }
 
 
@@ -82,14 +118,18 @@ uint64_t timer_read(void)
 
 void timer_init(void)
 {
-	/* configure timer 1 as a free-running CLK counter */
+	/*
+	 * Configure timer 1 as a free-running CLK counter. RZUSB gets the
+	 * transceiver interrupt from timer 1's input capture, so we leave the
+	 * settings for that alone.
+	 */
 
 	TCCR1A = 0;
-	TCCR1B = 1 << CS10;
+	TCCR1B |= 1 << CS10;
 
 	/* enable timer overflow interrupt */
 
-	TIMSK1 = 1 << TOIE1;
+	TIMSK1 |= 1 << TOIE1;
 }
 
 
@@ -154,6 +194,25 @@ static void done(void *user)
 
 uint8_t irq_serial;
 
+/*
+ * RX_START is where every attack begins, so the HardMAC's entry path avoids
+ * calls until it knows what happened: IRQ_STATUS is read right here, with
+ * the inline accessors of hal.h, and the MAC is called directly rather than
+ * through a pointer. (It can't come with the SPI status byte of the
+ * frame buffer read, which is set to PHY_RSSI for RX_CRC_VALID, and which
+ * the AT86RF230 can't set to IRQ_STATUS anyway.)
+ *
+ * an/wcet.py measures this path: build an attack that reads the frame,
+ * e.g., with ATTACKID=01, and "make wcet" reports the cycles from the IRQ
+ * edge to the PHR of the attack's frame buffer read as "PHR read at". It
+ * can't follow the indirect call the MAC was reached through before, so it
+ * has no figure for the old path.
+ *
+ * The prologue stays, since the path still calls C code. Beyond this, only
+ * an assembler entry stub that starts the frame buffer read itself would
+ * help, and the attacks would have to be changed to pick it up.
+ */
+
 #if defined(ATUSB) || defined(HULUSB)
 ISR(INT0_vect)
 #endif
@@ -161,8 +220,8 @@ ISR(INT0_vect)
 ISR(TIMER1_CAPT_vect)
 #endif
 {
-	if (mac_irq) {
-		if (mac_irq())
+	if (mac_irq_on) {
+		if (mac_irq(hal_reg_read(REG_IRQ_STATUS)))
 			return;
 	}
 	if (eps[1].state == EP_IDLE) {
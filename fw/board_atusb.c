@@ -25,9 +25,10 @@
 #include "at86rf230.h"
 #include "board.h"
 #include "spi.h"
+#include "hal.h"
 #include "usb/usb.h"
 
-static bool spi_initialized = 0;
+bool spi_initialized = 0;
 
 void reset_rf(void)
 {
@@ -104,9 +105,7 @@ void board_init(void)
 
 void spi_begin(void)
 {
-	if (!spi_initialized)
-		spi_init();
-	CLR(nSS);
+	hal_spi_begin();
 }
 
 void spi_off(void)
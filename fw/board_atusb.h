@@ -38,6 +38,18 @@
 #define SPI_WAIT_DONE()	while (!(UCSR1A & 1 << RXC1))
 #define SPI_DATA	UDR1
 
+/*
+ * Board capabilities. The ATmega32U2 only has 1 kB of SRAM and 176 bytes of
+ * endpoint DPRAM, which leaves no room for a second EP1 bank next to a 64
+ * bytes EP0.
+ */
+
+#define	BOARD_RX_BUFS	3	/* frames in the receive ring */
+#define	BOARD_EP1_BANKS	1	/* EP1 DPRAM banks */
+#define	BOARD_EP2_BANKS	1	/* EP2 DPRAM banks */
+#define	BOARD_TELEM_BUF	64	/* telemetry queue, bytes, power of two */
+#define	BOARD_TEMPLATE_BUF 128	/* TX templates, bytes */
+
 void set_clkm(void);
 void board_init(void);
 
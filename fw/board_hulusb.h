@@ -48,6 +48,19 @@
 #define SPI_WAIT_DONE()	while ((SPSR & (1 << SPIF)) == 0)
 #define SPI_DATA	SPDR
 
+/*
+ * Board capabilities. The AT90USB1287 has 8 kB of SRAM and 832 bytes of
+ * endpoint DPRAM, so we can afford a deep receive ring (32 maximum-size frames
+ * are about 135 ms of back-to-back traffic at 250 kbps) and a double-banked
+ * EP1.
+ */
+
+#define	BOARD_RX_BUFS	32	/* frames in the receive ring */
+#define	BOARD_EP1_BANKS	2	/* EP1 DPRAM banks */
+#define	BOARD_EP2_BANKS	2	/* EP2 DPRAM banks */
+#define	BOARD_TELEM_BUF	512	/* telemetry queue, bytes, power of two */
+#define	BOARD_TEMPLATE_BUF 1024 /* TX templates, bytes */
+
 void set_clkm(void);
 void board_init(void);
 
@@ -25,14 +25,131 @@
 
 #include "board.h"
 #include "spi.h"
+#include "flash.h"
 #include "atusb/ep0.h"
 
 
-#define	MS_TO_LOOPS(ms) ((uint32_t) (ms)*335)
+/*
+ * The loop below now also drives the flash writes, so we can't count loop
+ * iterations to measure time. Timer 1 isn't used in the boot loader, so we
+ * just let it run at 8 MHz/1024.
+ */
+
+#define	MS_TO_TICKS(ms) ((uint16_t) ((uint32_t) (ms)*(F_CPU/1024)/1000))
+
+
+#define	CRC_PAGES	32	/* most pages per ATUSB_FLASH_CRC */
 
 
 static void (*run_payload)(void) = 0;
 
+static bool (*dfu_setup)(const struct setup_request *setup);
+static uint8_t crc_buf[2*CRC_PAGES];
+
+
+/*
+ * The C runtime is about to initialize .data, which overlaps the marker, so
+ * we save the marker and the reset cause in GPIORs first.
+ */
+
+static void __attribute__((naked, used, section(".init3")))
+save_reset_cause(void)
+{
+	GPIOR0 = MCUSR;
+	GPIOR1 = *BOOT_MARKER_ADDR == BOOT_MARKER;
+	*BOOT_MARKER_ADDR = 0;
+}
+
+
+/*
+ * DFU_DETACH resets through the watchdog without a marker, and an external
+ * reset or a brown-out always give the host the usual window. If FASTBOOT is
+ * set, we also skip the window at power-up.
+ */
+
+static bool fast_boot(void)
+{
+	uint8_t cause = GPIOR0;
+
+	if ((cause & (1 << WDRF)) && GPIOR1)
+		return 1;
+#ifdef FASTBOOT
+	if (cause == (1 << PORF))
+		return 1;
+#endif
+	return 0;
+}
+
+
+static bool flash_idle(void)
+{
+	return dfu.state == dfuIDLE && !dfu_flash_ops->busy(1);
+}
+
+
+/*
+ * A download ends in dfuMANIFEST_SYNC, and only the host's DFU_GETSTATUS
+ * takes us on to dfuIDLE. If the host is gone by then, we still start the
+ * application once the last page is written.
+ */
+
+static bool boot_idle(void)
+{
+	switch (dfu.state) {
+	case dfuIDLE:
+	case dfuMANIFEST_SYNC:
+	case dfuMANIFEST:
+		return !dfu_flash_ops->busy(1);
+	default:
+		return 0;
+	}
+}
+
+
+static bool my_setup(const struct setup_request *setup)
+{
+	uint32_t addr, len;
+	uint16_t crc;
+	uint8_t i;
+
+	switch (setup->bmRequestType | setup->bRequest << 8) {
+	case ATUSB_FROM_DEV(ATUSB_FLASH_CRC):
+		if ((setup->wLength & 1) || setup->wLength > sizeof(crc_buf))
+			return 0;
+		if (!flash_idle())
+			return 0;
+		addr = (uint32_t) setup->wIndex*DFU_TRANSFER_SIZE;
+		for (i = 0; i != setup->wLength/2; i++) {
+			if (addr >= BOOT_ADDR)
+				return 0;
+			crc = flash_crc(addr, DFU_TRANSFER_SIZE);
+			crc_buf[2*i] = crc;
+			crc_buf[2*i+1] = crc >> 8;
+			addr += DFU_TRANSFER_SIZE;
+		}
+		usb_send(&eps[0], crc_buf, setup->wLength, NULL, NULL);
+		return 1;
+	case ATUSB_FROM_DEV(ATUSB_FLASH_IMAGE_CRC):
+		len = setup->wValue | (uint32_t) setup->wIndex << 16;
+		if (setup->wLength != 2 || len > BOOT_ADDR)
+			return 0;
+		if (!flash_idle())
+			return 0;
+		crc = flash_crc(0, len);
+		crc_buf[0] = crc;
+		crc_buf[1] = crc >> 8;
+		usb_send(&eps[0], crc_buf, 2, NULL, NULL);
+		return 1;
+	case ATUSB_TO_DEV(ATUSB_FLASH_DELTA):
+		if (setup->wLength || dfu.state != dfuIDLE)
+			return 0;
+		dfu_delta = 1;
+		return 1;
+	default:
+		return dfu_setup(setup);
+	}
+}
+
 
 int main(void)
 {
@@ -41,15 +158,19 @@ int main(void)
 	 * way to dissuade gcc from doing this.
 	 */
 	volatile int zero = 0;
-	uint32_t loop = 0;
 
 	board_init();
+	if (pgm_read_byte(zero) != 0xff && fast_boot())
+		run_payload();
+
 	reset_rf();
 
 	/* now we should be at 8 MHz */
 
 	usb_init();
 	dfu_init();
+	dfu_setup = user_setup;
+	user_setup = my_setup;
 
 	/* move interrupt vectors to the boot loader */
 	MCUCR = 1 << IVCE;
@@ -59,17 +180,21 @@ int main(void)
 
 	led(1);
 
-	while (loop != MS_TO_LOOPS(2500)) {
-		if (dfu.state == dfuIDLE && pgm_read_byte(zero) != 0xff)
-			loop++;
-		else
-			loop = 0;
+	TCNT1 = 0;
+	TCCR1B = 1 << CS12 | 1 << CS10;		/* clkIO/1024 */
+
+	while (TCNT1 < MS_TO_TICKS(2500)) {
+		dfu_flash_ops->poll();
+		if (!boot_idle() || pgm_read_byte(zero) == 0xff)
+			TCNT1 = 0;
 	}
 
 	led(0);
 
 	cli();
 
+	TCCR1B = 0;
+
 	usb_reset();
 	run_payload();
 
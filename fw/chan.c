@@ -0,0 +1,172 @@
+/*
+ * fw/chan.c - Channel switching with measured PLL settling times
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The transceiver only holds the PLL calibration of the channel it is on, so
+ * there is nothing we could load back when we return to a channel. What we
+ * can cache is the outcome: chan_calibrate runs both calibration loops once
+ * on each channel of a set, then times the PLL_LOCK interrupt while hopping
+ * through the set a few times. chan_settle then gives the slowest lock seen
+ * on the channel instead of the worst case of the datasheet, and a channel
+ * that didn't lock or calibrate is marked as such. The results describe the
+ * hardware, not its state, so they survive ATUSB_RF_RESET.
+ *
+ * Only chan_calibrate busy-waits, up to LOCK_TIMEOUT per lock, and it runs
+ * from EP0. chan_switch just retunes, with two register accesses, and leaves
+ * the waiting to the caller, so it can be used from interrupts.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "at86rf230.h"
+#include "board.h"
+#include "atusb/atusb.h"
+#include "mac.h"
+#include "timer.h"
+#include "chan.h"
+
+
+#define	SETTLE_US	200		/* uncalibrated channel */
+#define	MARGIN_US	4		/* on top of the slowest lock seen */
+#define	LOCK_TIMEOUT	TIMER_US(500)
+#define	CAL_TIMEOUT	TIMER_US(100) /* CF takes 35 us, DCU 6 us */
+#define	ROUNDS		4		/* lock measurements per channel */
+
+#define	CHANNELS	(CHAN_LAST-CHAN_FIRST+1)
+
+
+static uint8_t latency[CHANNELS];	/* ATUSB_CHAN_* or microseconds */
+
+
+static void tune(uint8_t channel)
+{
+	reg_write(REG_PHY_CC_CCA,
+	    (reg_read(REG_PHY_CC_CCA) & ~CHANNEL_MASK) | channel);
+}
+
+
+/* start a calibration loop and wait for the transceiver to clear "bit" */
+
+static bool pll_cal(uint8_t reg, uint8_t bit)
+{
+	uint16_t t0;
+
+	reg_write(reg, reg_read(reg) | bit);
+	t0 = TCNT1;
+	while (reg_read(reg) & bit)
+		if ((uint16_t) (TCNT1-t0) > CAL_TIMEOUT)
+			return 0;
+	return 1;
+}
+
+
+/*
+ * Tune and return the number of ticks until PLL_LOCK, or 0 if there was none.
+ * IRQ_MASK only lets PLL_LOCK through, so we can just watch the line.
+ */
+
+static uint16_t lock_time(uint8_t channel)
+{
+	uint16_t t0, t;
+
+	reg_read(REG_IRQ_STATUS);
+	tune(channel);
+	t0 = TCNT1;
+	do {
+		t = TCNT1-t0;
+		if (t > LOCK_TIMEOUT)
+			return 0;
+	}
+	while (!read_irq());
+	reg_read(REG_IRQ_STATUS);
+	return t ? t : 1;
+}
+
+
+bool chan_calibrate(uint16_t mask)
+{
+	uint8_t irq_mask;
+	uint16_t t;
+	uint8_t i, round, us;
+
+	if (!mask)
+		return 1;
+	if (mask & ~((1 << CHANNELS)-1))
+		return 0;
+
+	mac_rx(0);
+	irq_mask = reg_read(REG_IRQ_MASK);
+	reg_write(REG_IRQ_MASK, IRQ_PLL_LOCK);
+	change_state(TRX_CMD_PLL_ON);
+
+	for (i = 0; i != CHANNELS; i++) {
+		latency[i] = ATUSB_CHAN_UNKNOWN;
+		if (!(mask & 1 << i))
+			continue;
+		if (!lock_time(CHAN_FIRST+i) ||
+		    !pll_cal(REG_PLL_CF, PLL_CF_START) ||
+		    !pll_cal(REG_PLL_DCU, PLL_DCU_START))
+			latency[i] = ATUSB_CHAN_FAILED;
+	}
+
+	/* each channel is entered from its predecessor in the set */
+	for (round = 0; round != ROUNDS; round++)
+		for (i = 0; i != CHANNELS; i++) {
+			if (!(mask & 1 << i) || latency[i] == ATUSB_CHAN_FAILED)
+				continue;
+			t = lock_time(CHAN_FIRST+i);
+			if (!t) {
+				latency[i] = ATUSB_CHAN_FAILED;
+				continue;
+			}
+			t = (t+7) >> 3;
+			us = t < ATUSB_CHAN_FAILED ? t : ATUSB_CHAN_FAILED-1;
+			if (latency[i] == ATUSB_CHAN_UNKNOWN || us > latency[i])
+				latency[i] = us;
+		}
+
+	change_state(TRX_CMD_FORCE_TRX_OFF);
+	reg_read(REG_IRQ_STATUS);
+	reg_write(REG_IRQ_MASK, irq_mask);
+	clear_irq();
+	return 1;
+}
+
+
+uint16_t chan_settle(uint8_t channel)
+{
+	uint8_t us = latency[channel-CHAN_FIRST];
+
+	if (us == ATUSB_CHAN_UNKNOWN || us == ATUSB_CHAN_FAILED)
+		return TIMER_US(SETTLE_US);
+	return TIMER_US(us+MARGIN_US);
+}
+
+
+uint16_t chan_switch(uint8_t channel)
+{
+	tune(channel);
+	return chan_settle(channel);
+}
+
+
+uint8_t chan_latency(uint8_t *buf)
+{
+	uint8_t i;
+
+	for (i = 0; i != CHANNELS; i++)
+		buf[i] = latency[i];
+	return CHANNELS;
+}
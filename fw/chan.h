@@ -0,0 +1,45 @@
+/*
+ * fw/chan.h - Channel switching with measured PLL settling times
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef CHAN_H
+#define	CHAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#ifdef AT86RF212
+#define	CHAN_FIRST	0
+#define	CHAN_LAST	10
+#else
+#define	CHAN_FIRST	11
+#define	CHAN_LAST	26
+#endif
+
+
+/*
+ * Calibrate the PLL on each channel in "mask" (bit n for channel
+ * CHAN_FIRST+n) and measure how long it takes to lock, leaving the
+ * transceiver in TRX_OFF. A mask of 0 keeps the current results.
+ */
+bool chan_calibrate(uint16_t mask);
+
+/* timer 1 ticks the PLL needs to lock on "channel" */
+uint16_t chan_settle(uint8_t channel);
+
+/* switch channels without waiting, and return chan_settle(channel) */
+uint16_t chan_switch(uint8_t channel);
+
+/* per-channel latency in microseconds, as in ATUSB_CHAN_CAL */
+uint8_t chan_latency(uint8_t *buf);
+
+#endif /* !CHAN_H */
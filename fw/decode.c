@@ -0,0 +1,423 @@
+/*
+ * fw/decode.c - Decode Zigbee NWK, 6LoWPAN and MLE headers byte by byte
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The decoder is fed the MAC payload as it comes out of the frame buffer.
+ * Each header field is collected into "v" until it is complete. Then
+ * field() stores it, sets its "have" bit, and works out which field comes
+ * next and how long it is. Fields of length zero are skipped right away.
+ * Each byte costs a shift, plus one step of field() at the end of a field.
+ *
+ * We follow Zigbee NWK frames up to their auxiliary security header, and
+ * 6LoWPAN through FRAG1 or FRAGN, IPHC, and UDP (compressed or inline) to
+ * MLE. Anything else (mesh headers, other next headers, uncompressed IPv6)
+ * ends decoding without a payload offset.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "decode.h"
+
+
+enum state {
+	S_NWK_FC,
+	S_NWK_DST,
+	S_NWK_SRC,
+	S_NWK_RADIUS,
+	S_NWK_SEQ,
+	S_NWK_DST_IEEE,
+	S_NWK_SRC_IEEE,
+	S_NWK_MULTICAST,
+	S_NWK_RELAY_COUNT,
+	S_NWK_RELAY_INDEX,
+	S_NWK_RELAYS,
+	S_AUX_CTRL,
+	S_AUX_COUNTER,
+	S_AUX_SRC,
+	S_AUX_KEY,
+	S_DISPATCH,
+	S_FRAG1,
+	S_FRAGN,
+	S_IPHC,
+	S_IPHC_TF,		/* context identifier and traffic class */
+	S_IPHC_NH,
+	S_IPHC_ADDR,		/* hop limit and addresses */
+	S_NHC,
+	S_UDP_PORTS,
+	S_UDP_REST,		/* length and checksum */
+	S_MLE_SUITE,
+	S_MLE_CMD,
+};
+
+
+#define	SEC_KEY_ID(ctrl)	((ctrl) >> 3 & 3)
+#define	SEC_EXT_NONCE		0x20	/* Zigbee */
+
+#define	KEY_ID_NWK		1	/* Zigbee network key */
+
+#define	DISPATCH_IS_FRAG1(b)	(((b) & 0xf8) == 0xc0)
+#define	DISPATCH_IS_FRAGN(b)	(((b) & 0xf8) == 0xe0)
+#define	DISPATCH_IS_IPHC(b)	(((b) & 0xe0) == 0x60)
+
+#define	IPHC_TF(iphc)		((iphc) >> 11 & 3)
+#define	IPHC_NH			0x0400
+#define	IPHC_HLIM(iphc)		((iphc) >> 8 & 3)
+#define	IPHC_CID		0x0080
+#define	IPHC_SAC		0x0040
+#define	IPHC_SAM(iphc)		((iphc) >> 4 & 3)
+#define	IPHC_M			0x0008
+#define	IPHC_DAC		0x0004
+#define	IPHC_DAM(iphc)		((iphc) & 3)
+
+#define	NHC_IS_UDP(b)		(((b) & 0xf8) == 0xf0)
+#define	NHC_UDP_C		0x04
+#define	NHC_UDP_P(b)		((b) & 3)
+
+#define	NEXT_HEADER_UDP		17
+
+/* byte i of a packed table, so that small tables don't end up in RAM */
+#define	NTH(table, i)		((uint8_t) ((table) >> 8*(i)))
+
+#define	TF_LEN			0x00010304UL	/* 4, 3, 1, 0 */
+#define	UNICAST_LEN		0x00020810UL	/* 16, 8, 2, 0 */
+#define	MULTICAST_LEN		0x01040610UL	/* 16, 6, 4, 1 */
+
+
+/* ----- Helpers ----------------------------------------------------------- */
+
+
+static uint16_t le16(uint32_t v)
+{
+	return (uint16_t) v << 8 | (uint8_t) (v >> 8);
+}
+
+
+static uint32_t le32(uint32_t v)
+{
+	return (uint32_t) le16(v) << 16 | le16(v >> 16);
+}
+
+
+static void next(struct decode *d, uint8_t state, uint8_t len)
+{
+	d->state = state;
+	d->left = len;
+	d->v = 0;
+}
+
+
+static void end(struct decode *d)
+{
+	d->have |= DECODE_END;
+}
+
+
+static void payload(struct decode *d)
+{
+	d->payload = d->pos;
+	d->have |= DECODE_PAYLOAD | DECODE_END;
+}
+
+
+/* key identifier of an 802.15.4 (MLE) auxiliary security header */
+
+static uint8_t key_id_len(uint8_t ctrl)
+{
+	uint8_t mode = SEC_KEY_ID(ctrl);
+
+	return mode ? 4*mode-3 : 0;
+}
+
+
+/* ----- 6LoWPAN IPHC ------------------------------------------------------ */
+
+
+static uint8_t iphc_tf_len(uint16_t iphc)
+{
+	return NTH(TF_LEN, IPHC_TF(iphc))+(iphc & IPHC_CID ? 1 : 0);
+}
+
+
+static uint8_t iphc_addr_len(uint16_t iphc)
+{
+	uint8_t len;
+
+	len = IPHC_HLIM(iphc) ? 0 : 1;
+	if (!(iphc & IPHC_SAC) || IPHC_SAM(iphc))
+		len += NTH(UNICAST_LEN, IPHC_SAM(iphc));
+	if (!(iphc & IPHC_M)) {
+		if (!(iphc & IPHC_DAC) || IPHC_DAM(iphc))
+			len += NTH(UNICAST_LEN, IPHC_DAM(iphc));
+	} else if (iphc & IPHC_DAC) {
+		len += IPHC_DAM(iphc) ? 0 : 6;
+	} else {
+		len += NTH(MULTICAST_LEN, IPHC_DAM(iphc));
+	}
+	return len;
+}
+
+
+static void udp_ports(struct decode *d)
+{
+	uint32_t v = d->v;
+
+	if (!(d->iphc & IPHC_NH)) {
+		d->udp_src = v >> 16;
+		d->udp_dst = v;
+		return;
+	}
+	switch (NHC_UDP_P(d->nhc)) {
+	case 0:
+		d->udp_src = v >> 16;
+		d->udp_dst = v;
+		break;
+	case 1:
+		d->udp_src = v >> 8;
+		d->udp_dst = 0xf000 | (uint8_t) v;
+		break;
+	case 2:
+		d->udp_src = 0xf000 | (uint8_t) (v >> 16);
+		d->udp_dst = v;
+		break;
+	default:
+		d->udp_src = 0xf0b0 | (v >> 4 & 0xf);
+		d->udp_dst = 0xf0b0 | (v & 0xf);
+		break;
+	}
+}
+
+
+/* ----- Fields ------------------------------------------------------------ */
+
+
+static void nwk_hdr_done(struct decode *d)
+{
+	d->have |= DECODE_NWK_HDR;
+	if (d->nwk_fc & NWK_FC_SECURITY)
+		next(d, S_AUX_CTRL, 1);
+	else
+		payload(d);
+}
+
+
+static void field(struct decode *d)
+{
+	uint32_t v = d->v;
+	uint16_t fc = d->nwk_fc;
+
+	switch (d->state) {
+
+	/* Zigbee NWK */
+
+	case S_NWK_FC:
+		d->nwk_fc = le16(v);
+		d->have |= DECODE_NWK_FC;
+		next(d, S_NWK_DST, 2);
+		break;
+	case S_NWK_DST:
+		d->nwk_dst = le16(v);
+		next(d, S_NWK_SRC, 2);
+		break;
+	case S_NWK_SRC:
+		d->nwk_src = le16(v);
+		next(d, S_NWK_RADIUS, 1);
+		break;
+	case S_NWK_RADIUS:
+		d->nwk_radius = v;
+		next(d, S_NWK_SEQ, 1);
+		break;
+	case S_NWK_SEQ:
+		d->nwk_seq = v;
+		next(d, S_NWK_DST_IEEE, fc & NWK_FC_DST_IEEE ? 8 : 0);
+		break;
+	case S_NWK_DST_IEEE:
+		next(d, S_NWK_SRC_IEEE, fc & NWK_FC_SRC_IEEE ? 8 : 0);
+		break;
+	case S_NWK_SRC_IEEE:
+		next(d, S_NWK_MULTICAST, fc & NWK_FC_MULTICAST ? 1 : 0);
+		break;
+	case S_NWK_MULTICAST:
+		if (fc & NWK_FC_SRC_ROUTE)
+			next(d, S_NWK_RELAY_COUNT, 1);
+		else
+			nwk_hdr_done(d);
+		break;
+	case S_NWK_RELAY_COUNT:
+		d->relays = v;
+		next(d, S_NWK_RELAY_INDEX, 1);
+		break;
+	case S_NWK_RELAY_INDEX:
+		if (d->relays > 0x7f) {
+			end(d);
+			break;
+		}
+		next(d, S_NWK_RELAYS, 2*d->relays);
+		break;
+	case S_NWK_RELAYS:
+		nwk_hdr_done(d);
+		break;
+
+	/* auxiliary security header */
+
+	case S_AUX_CTRL:
+		d->sec_ctrl = v;
+		next(d, S_AUX_COUNTER, 4);
+		break;
+	case S_AUX_COUNTER:
+		d->frame_counter = le32(v);
+		if (d->proto == DECODE_NWK)
+			next(d, S_AUX_SRC, d->sec_ctrl & SEC_EXT_NONCE ? 8 : 0);
+		else
+			next(d, S_AUX_KEY, key_id_len(d->sec_ctrl));
+		break;
+	case S_AUX_SRC:
+		next(d, S_AUX_KEY,
+		    SEC_KEY_ID(d->sec_ctrl) == KEY_ID_NWK ? 1 : 0);
+		break;
+	case S_AUX_KEY:
+		d->key_seq = v;
+		d->have |= DECODE_AUX;
+		payload(d);
+		break;
+
+	/* 6LoWPAN */
+
+	case S_DISPATCH:
+		if (!(d->have & DECODE_DISPATCH)) {
+			d->dispatch = v;
+			d->have |= DECODE_DISPATCH;
+		}
+		if (DISPATCH_IS_FRAG1(v) && d->pos == 1) {
+			next(d, S_FRAG1, 3);
+		} else if (DISPATCH_IS_FRAGN(v) && d->pos == 1) {
+			next(d, S_FRAGN, 4);
+		} else if (DISPATCH_IS_IPHC(v)) {
+			d->iphc = v << 8;
+			next(d, S_IPHC, 1);
+		} else {
+			end(d);
+		}
+		break;
+	case S_FRAG1:
+		d->frag_size = (d->dispatch & 7) << 8 | (uint8_t) (v >> 16);
+		d->frag_tag = v;
+		d->frag_offset = 0;
+		d->have |= DECODE_FRAG;
+		next(d, S_DISPATCH, 1);
+		break;
+	case S_FRAGN:
+		d->frag_size = (d->dispatch & 7) << 8 | (uint8_t) (v >> 24);
+		d->frag_tag = v >> 8;
+		d->frag_offset = v;
+		d->have |= DECODE_FRAG;
+		payload(d);
+		break;
+	case S_IPHC:
+		d->iphc |= (uint8_t) v;
+		d->have |= DECODE_IPHC;
+		next(d, S_IPHC_TF, iphc_tf_len(d->iphc));
+		break;
+	case S_IPHC_TF:
+		if (d->iphc & IPHC_NH)
+			next(d, S_IPHC_ADDR, iphc_addr_len(d->iphc));
+		else
+			next(d, S_IPHC_NH, 1);
+		break;
+	case S_IPHC_NH:
+		d->next_header = v;
+		next(d, S_IPHC_ADDR, iphc_addr_len(d->iphc));
+		break;
+	case S_IPHC_ADDR:
+		if (d->iphc & IPHC_NH)
+			next(d, S_NHC, 1);
+		else if (d->next_header == NEXT_HEADER_UDP)
+			next(d, S_UDP_PORTS, 4);
+		else
+			payload(d);
+		break;
+	case S_NHC:
+		d->nhc = v;
+		if (!NHC_IS_UDP(v)) {
+			end(d);
+			break;
+		}
+		d->next_header = NEXT_HEADER_UDP;
+		next(d, S_UDP_PORTS,
+		    NHC_UDP_P(v) == 3 ? 1 : NHC_UDP_P(v) ? 3 : 4);
+		break;
+	case S_UDP_PORTS:
+		udp_ports(d);
+		d->have |= DECODE_UDP;
+		if (!(d->iphc & IPHC_NH))
+			next(d, S_UDP_REST, 4);
+		else
+			next(d, S_UDP_REST, d->nhc & NHC_UDP_C ? 0 : 2);
+		break;
+	case S_UDP_REST:
+		if (d->udp_src == DECODE_MLE_PORT ||
+		    d->udp_dst == DECODE_MLE_PORT)
+			next(d, S_MLE_SUITE, 1);
+		else
+			payload(d);
+		break;
+
+	/* MLE */
+
+	case S_MLE_SUITE:
+		d->mle_suite = v;
+		d->have |= DECODE_MLE;
+		if (v == DECODE_MLE_UNSECURED)
+			next(d, S_MLE_CMD, 1);
+		else if (!v)
+			next(d, S_AUX_CTRL, 1);
+		else
+			end(d);
+		break;
+	case S_MLE_CMD:
+		d->mle_cmd = v;
+		d->have |= DECODE_MLE_CMD;
+		payload(d);
+		break;
+
+	default:
+		end(d);
+		break;
+	}
+}
+
+
+/* ----- API --------------------------------------------------------------- */
+
+
+void decode_start(struct decode *d, uint8_t proto)
+{
+	memset(d, 0, sizeof(*d));
+	d->proto = proto;
+	if (proto == DECODE_NWK)
+		next(d, S_NWK_FC, 2);
+	else
+		next(d, S_DISPATCH, 1);
+}
+
+
+void decode_byte(struct decode *d, uint8_t b)
+{
+	if (d->have & DECODE_END)
+		return;
+	d->pos++;
+	d->v = d->v << 8 | b;
+	if (--d->left)
+		return;
+	do field(d);
+	while (!d->left && !(d->have & DECODE_END));
+}
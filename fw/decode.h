@@ -0,0 +1,115 @@
+/*
+ * fw/decode.h - Decode Zigbee NWK, 6LoWPAN and MLE headers byte by byte
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef DECODE_H
+#define	DECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* what the MAC payload carries */
+#define	DECODE_NWK	0	/* Zigbee NWK frame */
+#define	DECODE_LOWPAN	1	/* 6LoWPAN, maybe with UDP and MLE */
+
+/* fields known so far, in "have" */
+#define	DECODE_END	0x0001	/* nothing more we can decode */
+#define	DECODE_PAYLOAD	0x0002	/* "payload" is set */
+#define	DECODE_NWK_FC	0x0004
+#define	DECODE_NWK_HDR	0x0008	/* addresses, radius, sequence number */
+#define	DECODE_AUX	0x0010	/* NWK or MLE auxiliary security header */
+#define	DECODE_DISPATCH	0x0020
+#define	DECODE_FRAG	0x0040
+#define	DECODE_IPHC	0x0080
+#define	DECODE_UDP	0x0100	/* ports */
+#define	DECODE_MLE	0x0200	/* security suite */
+#define	DECODE_MLE_CMD	0x0400	/* unsecured MLE only */
+
+/* bits of nwk_fc, not of "have" */
+#define	NWK_FC_MULTICAST	0x0100
+#define	NWK_FC_SECURITY		0x0200
+#define	NWK_FC_SRC_ROUTE	0x0400
+#define	NWK_FC_DST_IEEE		0x0800
+#define	NWK_FC_SRC_IEEE		0x1000
+
+#define	DECODE_MLE_PORT		19788
+#define	DECODE_MLE_UNSECURED	255
+
+
+/*
+ * Fields are only valid once their bit is set in "have". Offsets count the
+ * bytes passed to decode_byte, which begin with the MAC payload.
+ */
+
+struct decode {
+	uint16_t have;
+	uint8_t pos;			/* bytes decoded so far */
+	uint8_t payload;		/* where the innermost payload begins */
+
+	/* Zigbee NWK */
+	uint16_t nwk_fc;
+	uint16_t nwk_dst;
+	uint16_t nwk_src;
+	uint8_t nwk_radius;
+	uint8_t nwk_seq;
+
+	/* auxiliary security header, of NWK or MLE */
+	uint8_t sec_ctrl;
+	uint32_t frame_counter;
+	uint8_t key_seq;		/* or MLE key index */
+
+	/* 6LoWPAN */
+	uint8_t dispatch;		/* of the first header */
+	uint16_t frag_size;
+	uint16_t frag_tag;
+	uint8_t frag_offset;		/* in units of 8 bytes, FRAGN only */
+	uint16_t iphc;
+	uint8_t next_header;		/* inline, or 17 for UDP NHC */
+	uint8_t nhc;
+	uint16_t udp_src;
+	uint16_t udp_dst;
+
+	/* MLE */
+	uint8_t mle_suite;
+	uint8_t mle_cmd;
+
+	/* private */
+	uint8_t proto;
+	uint8_t state;
+	uint8_t left;			/* bytes left in the current field */
+	uint8_t relays;
+	uint32_t v;
+};
+
+
+void decode_start(struct decode *d, uint8_t proto);
+void decode_byte(struct decode *d, uint8_t b);
+
+
+/*
+ * For attacks on 6LoWPAN first fragments with IPHC and NHC UDP: whether a
+ * header decoded so far is anything else. Call it after each decode_byte, so
+ * that each header is checked as soon as it is complete.
+ */
+
+static inline bool decode_not_frag1_udp(const struct decode *d)
+{
+	if ((d->have & DECODE_DISPATCH) && (d->dispatch & 0xf8) != 0xc0)
+		return 1;
+	if ((d->have & DECODE_IPHC) &&
+	    d->iphc != 0x7f33 && d->iphc != 0x7e33 && d->iphc != 0x7d33)
+		return 1;
+	/* nhc stays 0 until the NHC byte has been decoded */
+	return d->nhc && d->nhc != 0xf0;
+}
+
+#endif /* !DECODE_H */
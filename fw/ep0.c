@@ -36,6 +36,21 @@
 #include "sernum.h"
 #include "spi.h"
 #include "mac.h"
+#include "filter.h"
+#include "telemetry.h"
+#include "chan.h"
+#ifdef SCAN
+#include "scan.h"
+#endif
+#ifdef HOP
+#include "hop.h"
+#endif
+#ifdef TEMPLATE
+#include "template.h"
+#endif
+#ifdef BENCH
+#include "bench.h"
+#endif
 
 #ifdef ATUSB
 #define	HW_TYPE		ATUSB_HW_TYPE_110131
@@ -73,10 +88,34 @@ static void do_eeprom_write(void *user)
 		eeprom_update_byte((uint8_t*)i, buf[i]);
 }
 
+static void do_rx_filter(void *user)
+{
+	filter_set(buf);
+}
+
+#ifdef HOP
+static void do_hop(void *user)
+{
+	hop_start(buf, size);
+}
+#endif
+
+#ifdef TEMPLATE
+static uint8_t template_slot;
+
+static void do_template(void *user)
+{
+	template_set(template_slot, buf, size);
+}
+#endif
+
 static void do_buf_write(void *user)
 {
 	uint8_t i;
 
+#ifdef TEMPLATE
+	template_forget();
+#endif
 	spi_begin();
 	for (i = 0; i != size; i++)
 		spi_send(buf[i]);
@@ -125,6 +164,12 @@ static bool my_setup(const struct setup_request *setup)
 
 	case ATUSB_TO_DEV(ATUSB_RF_RESET):
 		debug("ATUSB_RF_RESET\n");
+#ifdef SCAN
+		scan_stop();
+#endif
+#ifdef HOP
+		hop_stop();
+#endif
 		reset_rf();
 		mac_reset();
 		//ep_send_zlp(EP_CTRL);
@@ -165,6 +210,17 @@ static bool my_setup(const struct setup_request *setup)
 		debug("ATUSB_SLP_TR\n");
 		slp_tr();
 		return 1;
+#ifdef BENCH
+	case ATUSB_FROM_DEV(ATUSB_BENCH):
+		debug("ATUSB_BENCH\n");
+		size = bench_run(setup->wValue, setup->wIndex, buf);
+		if (!size)
+			return 0;
+		if (setup->wLength < size)
+			size = setup->wLength;
+		usb_send(&eps[0], buf, size, NULL, NULL);
+		return 1;
+#endif
 
 	case ATUSB_TO_DEV(ATUSB_REG_WRITE):
 		debug("ATUSB_REG_WRITE\n");
@@ -250,6 +306,9 @@ static bool my_setup(const struct setup_request *setup)
 			do_buf_write(NULL);
 		return 1;
 	case ATUSB_FROM_DEV(ATUSB_SPI_WRITE2_SYNC):
+#ifdef TEMPLATE
+		template_forget();
+#endif
 		spi_begin();
 		spi_send(setup->wValue);
 		spi_send(setup->wIndex);
@@ -275,6 +334,77 @@ static bool my_setup(const struct setup_request *setup)
 		return mac_rx(setup->wValue);
 	case ATUSB_TO_DEV(ATUSB_TX):
 		return mac_tx(setup->wValue, setup->wIndex, setup->wLength);
+	case ATUSB_TO_DEV(ATUSB_RX_FILTER):
+		debug("ATUSB_RX_FILTER\n");
+		if (!setup->wLength) {
+			filter_set(NULL);
+			return 1;
+		}
+		if (setup->wLength != ATUSB_RX_FILTER_SIZE)
+			return 0;
+		usb_recv(&eps[0], buf, setup->wLength, do_rx_filter, NULL);
+		return 1;
+	case ATUSB_FROM_DEV(ATUSB_RX_STATS):
+		debug("ATUSB_RX_STATS\n");
+		size = mac_stats(buf);
+		if (setup->wLength < size)
+			size = setup->wLength;
+		usb_send(&eps[0], buf, size, NULL, NULL);
+		return 1;
+#ifdef SCAN
+	case ATUSB_TO_DEV(ATUSB_SCAN):
+		debug("ATUSB_SCAN\n");
+		return scan_start(setup->wValue, setup->wIndex);
+#endif
+	case ATUSB_FROM_DEV(ATUSB_CHAN_CAL):
+		debug("ATUSB_CHAN_CAL\n");
+		if (!chan_calibrate(setup->wValue))
+			return 0;
+		size = chan_latency(buf);
+		if (setup->wLength < size)
+			size = setup->wLength;
+		usb_send(&eps[0], buf, size, NULL, NULL);
+		return 1;
+#ifdef HOP
+	case ATUSB_TO_DEV(ATUSB_HOP):
+		debug("ATUSB_HOP\n");
+		if (!setup->wLength)
+			return hop_start(NULL, 0);
+		if (setup->wLength > ATUSB_HOP_SLOTS*ATUSB_HOP_ENTRY_SIZE)
+			return 0;
+		hop_stop();
+		size = setup->wLength;
+		usb_recv(&eps[0], buf, size, do_hop, NULL);
+		return 1;
+#endif
+#ifdef TEMPLATE
+	case ATUSB_TO_DEV(ATUSB_TEMPLATE):
+		debug("ATUSB_TEMPLATE\n");
+		if (setup->wValue >= ATUSB_TEMPLATE_SLOTS)
+			return 0;
+		if (setup->wLength > MAX_PSDU)
+			return 0;
+		if (!template_fits(setup->wValue, setup->wLength))
+			return 0;
+		template_slot = setup->wValue;
+		size = setup->wLength;
+		if (size)
+			usb_recv(&eps[0], buf, size, do_template, NULL);
+		else
+			do_template(NULL);
+		return 1;
+	case ATUSB_TO_DEV(ATUSB_TX_TEMPLATE):
+		debug("ATUSB_TX_TEMPLATE\n");
+		if (setup->wValue >= ATUSB_TEMPLATE_SLOTS)
+			return 0;
+		return mac_tx_template(setup->wValue, setup->wIndex,
+		    setup->wLength);
+#endif
+#ifdef TX_AT
+	case ATUSB_TO_DEV(ATUSB_TX_AT):
+		debug("ATUSB_TX_AT\n");
+		return mac_tx_at(setup->wIndex, setup->wLength);
+#endif
 	case ATUSB_TO_DEV(ATUSB_EUI64_WRITE):
 		debug("ATUSB_EUI64_WRITE\n");
 		usb_recv(&eps[0], buf, setup->wLength, do_eeprom_write, NULL);
@@ -325,7 +455,8 @@ static void my_set_interface(int nth)
 static void my_reset(void)
 {
 	if (dfu.state == appDETACH)
-		reset_cpu();
+		reset_dfu();
+	telemetry_reset();
 }
 
 
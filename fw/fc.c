@@ -0,0 +1,102 @@
+/*
+ * fw/fc.c - MAC header layout by frame control field
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Where the header fields are only depends on the two addressing modes,
+ * PAN ID compression, and whether the sequence number is suppressed (2015
+ * frames only). That's six bits, so we look the layout up in a table of 64
+ * entries in flash instead of working it out field by field.
+ *
+ * As in filter.c, PAN ID compression follows IEEE 802.15.4-2006: the source
+ * PAN ID is left out if the bit is set, even if there is no destination.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/pgmspace.h>
+
+#include "fc.h"
+
+
+/* ----- Layout table ------------------------------------------------------ */
+
+
+/* index bits */
+#define	I_DST(i)	((i) & 3)
+#define	I_SRC(i)	((i) >> 2 & 3)
+#define	I_PAN_COMP(i)	((i) >> 4 & 1)
+#define	I_SEQ_SUPP(i)	((i) >> 5 & 1)
+
+#define	ADDR_LEN(mode) \
+    ((mode) == FC_ADDR_SHORT ? 2 : (mode) == FC_ADDR_EXT ? 8 : 0)
+#define	SRC_PAN_LEN(i)	(I_SRC(i) && !I_PAN_COMP(i) ? 2 : 0)
+
+#define	END_SEQ(i)	(3-I_SEQ_SUPP(i))
+#define	END_DST(i)	(END_SEQ(i)+(I_DST(i) ? 2+ADDR_LEN(I_DST(i)) : 0))
+
+#define	SEQ(i)		(I_SEQ_SUPP(i) ? 0 : 2)
+#define	DST_PAN(i)	(I_DST(i) ? END_SEQ(i) : 0)
+#define	DST(i)		(I_DST(i) ? END_SEQ(i)+2 : 0)
+#define	SRC_PAN(i) \
+    (!I_SRC(i) ? 0 : I_PAN_COMP(i) ? DST_PAN(i) : END_DST(i))
+#define	SRC(i)		(I_SRC(i) ? END_DST(i)+SRC_PAN_LEN(i) : 0)
+#define	AUX(i)		(END_DST(i)+SRC_PAN_LEN(i)+ADDR_LEN(I_SRC(i)))
+#define	FLAGS(i) \
+    (I_DST(i) == 1 || I_SRC(i) == 1 ? FC_LAYOUT_REJECT : 0)
+
+#define	L(i)	{ SEQ(i), DST_PAN(i), DST(i), SRC_PAN(i), SRC(i), AUX(i), \
+		  FLAGS(i) }
+#define	L4(i)	L(i), L((i)+1), L((i)+2), L((i)+3)
+#define	L16(i)	L4(i), L4((i)+4), L4((i)+8), L4((i)+12)
+
+
+static const struct fc_layout layouts[64] PROGMEM = {
+	L16(0), L16(16), L16(32), L16(48)
+};
+
+
+/* ----- Lookup ------------------------------------------------------------ */
+
+
+#define	VERSION_2015	(2 << FC_VERSION_SHIFT)
+#define	VERSION_MASK	(3 << FC_VERSION_SHIFT)
+
+#define	SEC_KEY_ID_SHIFT 3
+#define	SEC_CTR_SUPP	0x20	/* 2015 frames only */
+
+
+void fc_layout(struct fc_layout *layout, const uint8_t *fc)
+{
+	uint8_t i;
+
+	i = FC_DST_MODE(fc) | FC_SRC_MODE(fc) << 2 | (fc[0] & FC_PAN_COMP) >> 2;
+	if ((fc[1] & (VERSION_MASK | FC_SEQ_SUPP)) ==
+	    (VERSION_2015 | FC_SEQ_SUPP))
+		i |= 0x20;
+	memcpy_P(layout, layouts+i, sizeof(*layout));
+}
+
+
+uint8_t fc_payload(const struct fc_layout *layout, const uint8_t *psdu)
+{
+	uint8_t sec, mode, len;
+
+	if (!(psdu[0] & FC_SECURITY))
+		return layout->aux;
+	sec = psdu[layout->aux];
+	mode = sec >> SEC_KEY_ID_SHIFT & 3;
+	len = 1+(mode ? 4*mode-3 : 0);		/* key identifier: 0, 1, 5, 9 */
+	if ((psdu[1] & VERSION_MASK) != VERSION_2015 || !(sec & SEC_CTR_SUPP))
+		len += 4;			/* frame counter */
+	return layout->aux+len;
+}
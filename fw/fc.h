@@ -0,0 +1,60 @@
+/*
+ * fw/fc.h - MAC header layout by frame control field
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef FC_H
+#define	FC_H
+
+#include <stdint.h>
+
+
+#define	FC_TYPE_MASK	0x07	/* first byte */
+#define	FC_SECURITY	0x08
+#define	FC_PAN_COMP	0x40
+#define	FC_SEQ_SUPP	0x01	/* second byte */
+#define	FC_DST_SHIFT	2
+#define	FC_VERSION_SHIFT 4
+#define	FC_SRC_SHIFT	6
+
+#define	FC_ADDR_NONE	0
+#define	FC_ADDR_SHORT	2
+#define	FC_ADDR_EXT	3
+
+#define	FC_DST_MODE(fc)	((fc)[1] >> FC_DST_SHIFT & 3)
+#define	FC_SRC_MODE(fc)	((fc)[1] >> FC_SRC_SHIFT & 3)
+
+#define	FC_LAYOUT_REJECT 0x01	/* reserved addressing mode */
+
+
+/*
+ * Offsets into the PSDU, which begins with the frame control field, so 0
+ * means that the frame has no such field. "aux" is where the addressing
+ * fields end: the auxiliary security header if FC_SECURITY is set, the
+ * payload (or header IEs) otherwise.
+ */
+
+struct fc_layout {
+	uint8_t seq;
+	uint8_t dst_pan;
+	uint8_t dst;
+	uint8_t src_pan;
+	uint8_t src;
+	uint8_t aux;
+	uint8_t flags;
+};
+
+
+void fc_layout(struct fc_layout *layout, const uint8_t *fc);
+
+/* needs the PSDU up to the security control field, if there is one */
+uint8_t fc_payload(const struct fc_layout *layout, const uint8_t *psdu);
+
+#endif /* !FC_H */
@@ -0,0 +1,229 @@
+/*
+ * fw/filter.c - Drop uninteresting frames before they are read
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The tests are ordered by how much of the frame they need: the CRC status
+ * comes with the first SPI byte and the length with the second, the frame
+ * type needs the frame control field, and only the address tests need the
+ * rest of the MAC header. A frame that is dropped is never read any further.
+ *
+ * The header layout comes from the table in fc.c, which follows IEEE
+ * 802.15.4-2006, plus sequence number suppression of 2015 frames. Header IEs
+ * come after the addresses and don't matter here.
+ *
+ * With ATUSB_RX_FILTER_HW, we also program the transceiver's own address
+ * filter and leave promiscuous mode, so that frames for other destinations
+ * don't even raise TRX_END. The transceiver always lets broadcasts through
+ * and only looks at the destination, so the tests above still run on what it
+ * passes. We don't ACK anything, and we put back the host's settings when the
+ * filter goes away.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "at86rf230.h"
+#include "spi.h"
+#include "hal.h"
+#include "board.h"
+#include "atusb/atusb.h"
+#include "fc.h"
+#include "filter.h"
+
+
+#define	FILTER_ADDR	(ATUSB_RX_FILTER_PAN | ATUSB_RX_FILTER_SHORT | \
+			    ATUSB_RX_FILTER_EXT)
+
+
+bool filter_on = 0;
+
+static uint8_t flags;
+static uint8_t types;
+static uint8_t min_len;
+static uint8_t pan[2];
+static uint8_t short_addr[2];
+static uint8_t ext_addr[8];
+
+#ifndef AT86RF230
+
+#define	ADDR_REGS	(REG_IEEE_ADDR_7-REG_SHORT_ADDR_0+1)
+
+static bool hw_on = 0;
+static uint8_t saved_addr[ADDR_REGS];	/* SHORT_ADDR, PAN_ID, IEEE_ADDR */
+static uint8_t saved_xah_ctrl_1, saved_csma_seed_1;
+
+#endif /* !AT86RF230 */
+
+
+static bool is(const uint8_t *p, const uint8_t *want)
+{
+	return p[0] == want[0] && p[1] == want[1];
+}
+
+
+static bool is_broadcast(const uint8_t *p)
+{
+	return (flags & ATUSB_RX_FILTER_BROADCAST) &&
+	    p[0] == 0xff && p[1] == 0xff;
+}
+
+
+static bool addr_match(const uint8_t *p, uint8_t mode, bool dst)
+{
+	switch (mode) {
+	case FC_ADDR_SHORT:
+		return (flags & ATUSB_RX_FILTER_SHORT) &&
+		    (is(p, short_addr) || (dst && is_broadcast(p)));
+	case FC_ADDR_EXT:
+		return (flags & ATUSB_RX_FILTER_EXT) &&
+		    !memcmp(p, ext_addr, 8);
+	default:
+		return 0;
+	}
+}
+
+
+bool filter_frame(uint8_t status, uint8_t *psdu, uint8_t size, uint8_t *got)
+{
+	struct fc_layout l;
+	const uint8_t *dst_pan, *src_pan, *dst, *src;
+
+	*got = 0;
+#ifndef AT86RF230
+	/* the SPI status byte is PHY_RSSI, see mac_reset */
+	if ((flags & ATUSB_RX_FILTER_CRC) && !(status & RX_CRC_VALID))
+		return 0;
+#endif
+	if ((flags & ATUSB_RX_FILTER_MIN_LEN) && size < min_len)
+		return 0;
+	if (!(flags & (ATUSB_RX_FILTER_TYPE | FILTER_ADDR)))
+		return 1;
+
+	if (size < 2+2)		/* frame control and FCS */
+		return 0;
+	psdu[0] = hal_spi_io(0);
+	psdu[1] = hal_spi_io(0);
+	*got = 2;
+	if ((flags & ATUSB_RX_FILTER_TYPE) &&
+	    !(types & 1 << (psdu[0] & FC_TYPE_MASK)))
+		return 0;
+	if (!(flags & FILTER_ADDR))
+		return 1;
+
+	fc_layout(&l, psdu);
+	if (l.flags & FC_LAYOUT_REJECT)
+		return 0;
+	if (l.aux+2 > size)
+		return 0;
+	while (*got != l.aux)
+		psdu[(*got)++] = hal_spi_io(0);
+
+	dst_pan = l.dst_pan ? psdu+l.dst_pan : NULL;
+	dst = l.dst ? psdu+l.dst : NULL;
+	src_pan = l.src_pan ? psdu+l.src_pan : NULL;
+	src = l.src ? psdu+l.src : NULL;
+
+	if (flags & ATUSB_RX_FILTER_PAN)
+		if (!(dst_pan && (is(dst_pan, pan) || is_broadcast(dst_pan))) &&
+		    !(src_pan && is(src_pan, pan)))
+			return 0;
+	if (!(flags & (ATUSB_RX_FILTER_SHORT | ATUSB_RX_FILTER_EXT)))
+		return 1;
+	return (dst && addr_match(dst, FC_DST_MODE(psdu), 1)) ||
+	    (src && addr_match(src, FC_SRC_MODE(psdu), 0));
+}
+
+
+/* ----- Transceiver address filter --------------------------------------- */
+
+
+#ifndef AT86RF230
+
+static void hw_filter(bool on)
+{
+	uint8_t i;
+
+	if (on && !hw_on) {
+		for (i = 0; i != ADDR_REGS; i++)
+			saved_addr[i] = reg_read(REG_SHORT_ADDR_0+i);
+		saved_xah_ctrl_1 = reg_read(REG_XAH_CTRL_1);
+		saved_csma_seed_1 = reg_read(REG_CSMA_SEED_1);
+	}
+	if (on) {
+		/* 0xfffe is "no short address", 0 nobody's extended one */
+		reg_write(REG_SHORT_ADDR_0,
+		    flags & ATUSB_RX_FILTER_SHORT ? short_addr[0] : 0xfe);
+		reg_write(REG_SHORT_ADDR_1,
+		    flags & ATUSB_RX_FILTER_SHORT ? short_addr[1] : 0xff);
+		reg_write(REG_PAN_ID_0, pan[0]);
+		reg_write(REG_PAN_ID_1, pan[1]);
+		for (i = 0; i != 8; i++)
+			reg_write(REG_IEEE_ADDR_0+i,
+			    flags & ATUSB_RX_FILTER_EXT ? ext_addr[i] : 0);
+
+		/* filter reserved frame types too, and upload them */
+		reg_write(REG_XAH_CTRL_1,
+		    (saved_xah_ctrl_1 & ~AACK_PROM_MODE) |
+		    AACK_FLTR_RES_FT | AACK_UPLD_RES_FT);
+
+		/*
+		 * Accept all frame versions, don't ACK, and act as coordinator,
+		 * so that frames without a destination address reach us too.
+		 */
+		reg_write(REG_CSMA_SEED_1,
+		    saved_csma_seed_1 | AACK_FVN_MODE_ANY << AACK_FVN_MODE_SHIFT |
+		    AACK_DIS_ACK | I_AM_COORD);
+	} else if (hw_on) {
+		for (i = 0; i != ADDR_REGS; i++)
+			reg_write(REG_SHORT_ADDR_0+i, saved_addr[i]);
+		reg_write(REG_XAH_CTRL_1, saved_xah_ctrl_1);
+		reg_write(REG_CSMA_SEED_1, saved_csma_seed_1);
+	}
+	hw_on = on;
+}
+
+#endif /* !AT86RF230 */
+
+
+/* ----- Configuration ----------------------------------------------------- */
+
+
+void filter_set(const uint8_t *buf)
+{
+	if (!buf) {
+		filter_on = 0;
+		flags = 0;
+	} else {
+		flags = buf[0];
+		types = buf[1];
+		min_len = buf[2];
+		memcpy(pan, buf+4, 2);
+		memcpy(short_addr, buf+6, 2);
+		memcpy(ext_addr, buf+8, 8);
+		filter_on = flags != 0;
+	}
+#ifndef AT86RF230
+	hw_filter((flags & ATUSB_RX_FILTER_HW) &&
+	    (flags & ATUSB_RX_FILTER_PAN));
+#endif
+}
+
+
+void filter_reset(void)
+{
+	filter_on = 0;
+	flags = 0;
+#ifndef AT86RF230
+	hw_on = 0;
+#endif
+}
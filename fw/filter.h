@@ -0,0 +1,36 @@
+/*
+ * fw/filter.h - Drop uninteresting frames before they are read
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef FILTER_H
+#define	FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+extern bool filter_on;
+
+
+/*
+ * Decide whether to keep a frame whose frame buffer read has got as far as
+ * the PHR. Only as much of the MAC header as needed is read into psdu, and
+ * *got says how many bytes that was.
+ */
+bool filter_frame(uint8_t status, uint8_t *psdu, uint8_t size, uint8_t *got);
+
+/* set from an ATUSB_RX_FILTER payload, or turn off if buf is NULL */
+void filter_set(const uint8_t *buf);
+
+/* forget the filter after the transceiver has been reset */
+void filter_reset(void);
+
+#endif /* !FILTER_H */
@@ -10,16 +10,50 @@
  * (at your option) any later version.
  */
 
+/*
+ * Incoming data is collected in two page buffers. When one is full, the main
+ * loop programs it while the host sends the next block into the other one.
+ * We never wait for the SPM engine: poll() loads the temporary page buffer,
+ * starts the erase, and comes back for the write once the erase is done
+ * ("alternative 1" in the self-programming chapter of the data sheet).
+ */
+
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <avr/boot.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
 
 #include "dfu.h"
 #include "board.h"
+#include "flash.h"
+
 
+#define	PAGE_MASK	(SPM_PAGESIZE-1)
+#define	SPM_MS		5	/* page erase or write, 4.5 ms maximum */
+
+
+enum page_state {
+	page_free,		/* empty or being filled */
+	page_queued,		/* full, waiting for or being programmed */
+};
+
+static enum {
+	spm_idle,
+	spm_erase,
+	spm_write,
+} spm_state = spm_idle;
+
+static uint8_t page_buf[2][SPM_PAGESIZE];
+static uint32_t page_addr[2];
+static volatile uint8_t page_state[2];
+static uint8_t fill_idx = 0;		/* buffer we copy new data into */
+static uint8_t spm_idx = 0;		/* buffer we program next */
+static volatile bool rww_pending = 0;	/* re-enable RWW when all is done */
 
 static uint32_t payload;
 
@@ -30,44 +64,144 @@ static void flash_start(void)
 }
 
 
+static uint16_t room(void)
+{
+	uint16_t n = 0;
+
+	if (page_state[fill_idx] == page_free)
+		n = SPM_PAGESIZE-(payload & PAGE_MASK);
+	if (page_state[fill_idx ^ 1] == page_free)
+		n += SPM_PAGESIZE;
+	return n;
+}
+
+
+/*
+ * DFU_DNLOAD may skip ahead to any page, as long as we're not in the middle
+ * of one.
+ */
+
+static bool flash_seek(uint32_t pos)
+{
+	if ((pos & PAGE_MASK) || (payload & PAGE_MASK) || pos >= BOOT_ADDR)
+		return 0;
+	payload = pos;
+	return 1;
+}
+
+
 static bool flash_can_write(uint16_t size)
 {
-	return payload+size <= BOOT_ADDR;
+	return payload+size <= BOOT_ADDR && size <= room();
 }
 
 
-static void flash_write(const uint8_t *buf, uint16_t size)
+static void queue_page(void)
 {
-	static uint8_t last;
-	const uint8_t *p;
+	page_state[fill_idx] = page_queued;
+	fill_idx ^= 1;
+}
 
-	for (p = buf; p != buf+size; p++) {
-		if (!(payload & (SPM_PAGESIZE-1))) {
-			boot_page_erase(payload);
-			boot_spm_busy_wait();
-		}
 
-		if (payload & 1)
-			boot_page_fill(payload, last | (*p << 8));
-		else
-			last = *p;
-		payload++;
+static void flash_write(const uint8_t *buf, uint16_t size)
+{
+	uint16_t off;
 
-		if (!(payload & (SPM_PAGESIZE-1))) {
-			boot_page_write(payload-SPM_PAGESIZE);
-			boot_spm_busy_wait();
-		}
+	while (size--) {
+		off = payload & PAGE_MASK;
+		if (!off)
+			page_addr[fill_idx] = payload;
+		page_buf[fill_idx][off] = *buf++;
+		payload++;
+		if (!(payload & PAGE_MASK))
+			queue_page();
 	}
 }
 
 
 static void flash_end_write(void)
 {
-	if (payload & (SPM_PAGESIZE-1)) {
-		boot_page_write(payload & ~(SPM_PAGESIZE-1));
-		boot_spm_busy_wait();
+	uint16_t off = payload & PAGE_MASK;
+
+	if (off) {
+		memset(page_buf[fill_idx]+off, 0xff, SPM_PAGESIZE-off);
+		payload += SPM_PAGESIZE-off;
+		queue_page();
+	}
+	rww_pending = 1;
+}
+
+
+static uint16_t flash_busy(bool all)
+{
+	uint8_t ops = 0;
+
+	if (!all && room() >= DFU_TRANSFER_SIZE)
+		return 0;
+	switch (spm_state) {
+	case spm_idle:
+		if (page_state[spm_idx] == page_queued)
+			ops = 2;
+		break;
+	case spm_erase:
+		ops = 2;
+		break;
+	case spm_write:
+		ops = 1;
+		break;
+	}
+	if (all && page_state[spm_idx ^ 1] == page_queued)
+		ops += 2;
+	if (ops)
+		return ops*SPM_MS;
+	/* poll() hasn't caught up yet */
+	return !all || rww_pending;
+}
+
+
+/*
+ * SPM has to follow the write to SPMCSR within four cycles, so we must not
+ * be interrupted in between.
+ */
+
+static void flash_poll(void)
+{
+	const uint8_t *p;
+	uint32_t addr;
+	uint16_t i;
+
+	if (boot_spm_busy())
+		return;
+	addr = page_addr[spm_idx];
+	switch (spm_state) {
+	case spm_idle:
+		if (page_state[spm_idx] != page_queued) {
+			if (rww_pending) {
+				ATOMIC_BLOCK(ATOMIC_FORCEON)
+					boot_rww_enable();
+				rww_pending = 0;
+			}
+			break;
+		}
+		p = page_buf[spm_idx];
+		for (i = 0; i != SPM_PAGESIZE; i += 2)
+			ATOMIC_BLOCK(ATOMIC_FORCEON)
+				boot_page_fill(addr+i, p[i] | p[i+1] << 8);
+		ATOMIC_BLOCK(ATOMIC_FORCEON)
+			boot_page_erase(addr);
+		spm_state = spm_erase;
+		break;
+	case spm_erase:
+		ATOMIC_BLOCK(ATOMIC_FORCEON)
+			boot_page_write(addr);
+		spm_state = spm_write;
+		break;
+	case spm_write:
+		page_state[spm_idx] = page_free;
+		spm_idx ^= 1;
+		spm_state = spm_idle;
+		break;
 	}
-	boot_rww_enable();
 }
 
 
@@ -85,11 +219,24 @@ static uint16_t flash_read(uint8_t *buf, uint16_t size)
 }
 
 
+uint16_t flash_crc(uint32_t addr, uint32_t len)
+{
+	uint16_t crc = 0xffff;
+
+	while (len--)
+		crc = _crc_ccitt_update(crc, pgm_read_byte(addr++));
+	return crc;
+}
+
+
 static const struct dfu_flash_ops flash_ops = {
 	.start		= flash_start,
+	.seek		= flash_seek,
 	.can_write	= flash_can_write,
 	.write		= flash_write,
 	.end_write	= flash_end_write,
+	.busy		= flash_busy,
+	.poll		= flash_poll,
 	.read		= flash_read,
 };
 
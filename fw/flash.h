@@ -1,8 +1,5 @@
 /*
- * fw/attacks/attack_13.h - Declaration of the attack_13 functions
- *
- * Written 2021 by Dimitrios-Georgios Akestoridis
- * Copyright 2021 Dimitrios-Georgios Akestoridis
+ * fw/flash.h - Board-specific flash functions
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -10,9 +7,12 @@
  * (at your option) any later version.
  */
 
-#ifndef ATTACK_13_H
-#define	ATTACK_13_H
+#ifndef FLASH_H
+#define	FLASH_H
+
+#include <stdint.h>
+
 
-void start_timer(void);
+uint16_t flash_crc(uint32_t addr, uint32_t len);
 
-#endif /* !ATTACK_13_H */
+#endif /* !FLASH_H */
@@ -0,0 +1,76 @@
+/*
+ * fw/hal.h - Inline access to the transceiver's SPI and control lines
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Each board_*.h names its SPI data register (SPI_DATA), how to wait for a
+ * byte (SPI_WAIT_DONE), and the nSS and SLP_TR pins. From these, we make
+ * accessors that compile to a few instructions, without a call. spi.c,
+ * board.c, and the board_*.c files build the out-of-line versions from the
+ * same accessors. Code that runs per byte of a frame being received, such as
+ * the attacks, uses these, and everything else keeps calling the out-of-line
+ * functions to save flash.
+ */
+
+#ifndef HAL_H
+#define	HAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "at86rf230.h"
+#include "board.h"
+#include "spi.h"
+
+
+static inline void hal_spi_begin(void)
+{
+	if (!spi_initialized)
+		spi_init();
+	CLR(nSS);
+}
+
+
+static inline uint8_t hal_spi_io(uint8_t v)
+{
+	SPI_DATA = v;
+	SPI_WAIT_DONE();
+	return SPI_DATA;
+}
+
+
+static inline void hal_spi_end(void)
+{
+	SET(nSS);
+}
+
+
+static inline uint8_t hal_reg_read(uint8_t reg)
+{
+	uint8_t value;
+
+	hal_spi_begin();
+	hal_spi_io(AT86RF230_REG_READ | reg);
+	value = hal_spi_io(0);
+	hal_spi_end();
+	return value;
+}
+
+
+static inline void hal_slp_tr(void)
+{
+	SET(SLP_TR);
+	CLR(SLP_TR);
+}
+
+#endif /* !HAL_H */
@@ -0,0 +1,149 @@
+/*
+ * fw/hop.c - Channel hopping on a schedule kept in the device
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Hops are timed by timer 1's compare A interrupt. Compare times always
+ * advance from the previous one, not from when the interrupt ran, so
+ * interrupt latency doesn't add up over the schedule. Dwell times that
+ * don't fit in the 16 bit timer take several compares.
+ *
+ * Each channel is tuned ahead of its slot by the time chan_settle gives for
+ * it, so that the PLL is locked when the slot begins, as long as the dwell
+ * times leave room for this.
+ *
+ * A hop never cuts into a frame: while the transceiver is receiving, or has
+ * a frame we haven't read yet, we try again a little later, and take the
+ * delay off the next dwell time. The channel in the record trailer is
+ * therefore always the one the frame came in on.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "at86rf230.h"
+#include "board.h"
+#include "atusb/atusb.h"
+#include "timer.h"
+#include "chan.h"
+#include "hop.h"
+
+
+#define	STEP		0x4000			/* longest single wait */
+#define	RETRY_TICKS	TIMER_US(32)		/* frame in progress */
+#define	MIN_TICKS	TIMER_US(ATUSB_HOP_MIN_DWELL)
+
+
+static uint8_t sched[ATUSB_HOP_SLOTS][ATUSB_HOP_ENTRY_SIZE];
+static uint8_t slots = 0;		/* 0 if not hopping */
+static uint8_t slot;
+static uint32_t left;			/* ticks until the next hop */
+static uint32_t late;			/* ticks the pending hop was put off */
+
+
+static uint32_t dwell_ticks(const uint8_t *e)
+{
+	return TIMER_US((uint32_t) e[1] | (uint32_t) e[2] << 8 |
+	    (uint32_t) e[3] << 16);
+}
+
+
+static void wait(void)
+{
+	uint16_t step;
+
+	/* split so that the last wait is never short */
+	step = left > 2*STEP ? STEP : left;
+	left -= step;
+	OCR1A += step;
+}
+
+
+static bool receiving(void)
+{
+	uint8_t status;
+
+	if (read_irq())
+		return 1;
+	status = reg_read(REG_TRX_STATUS) & TRX_STATUS_MASK;
+	return status == TRX_STATUS_BUSY_RX ||
+	    status == TRX_STATUS_BUSY_RX_AACK;
+}
+
+
+static void hop(void)
+{
+	uint8_t next;
+	int32_t t;
+
+	slot = slot+1 == slots ? 0 : slot+1;
+	next = slot+1 == slots ? 0 : slot+1;
+	t = dwell_ticks(sched[slot]);
+	t += chan_switch(sched[slot][0]);	/* this slot begins when locked */
+	t -= chan_settle(sched[next][0]);	/* the next one is tuned early */
+	t -= (int32_t) late;
+	left = t >= (int32_t) MIN_TICKS ? (uint32_t) t : MIN_TICKS;
+	late = 0;
+}
+
+
+ISR(TIMER1_COMPA_vect)
+{
+	if (!left) {
+		if (receiving()) {
+			late += RETRY_TICKS;
+			OCR1A += RETRY_TICKS;
+			return;
+		}
+		hop();
+	}
+	wait();
+}
+
+
+bool hop_start(const uint8_t *buf, uint8_t len)
+{
+	const uint8_t *e;
+
+	hop_stop();
+	if (!len)
+		return 1;
+	if (len % ATUSB_HOP_ENTRY_SIZE || len > sizeof(sched))
+		return 0;
+	for (e = buf; e != buf+len; e += ATUSB_HOP_ENTRY_SIZE) {
+		if ((uint8_t) (e[0]-CHAN_FIRST) > CHAN_LAST-CHAN_FIRST)
+			return 0;
+		if (dwell_ticks(e) < MIN_TICKS)
+			return 0;
+	}
+	memcpy(sched, buf, len);
+	slots = len/ATUSB_HOP_ENTRY_SIZE;
+	slot = slots-1;
+	late = 0;
+
+	hop();
+	OCR1A = TCNT1;
+	wait();
+	TIFR1 = 1 << OCF1A;
+	TIMSK1 |= 1 << OCIE1A;
+	return 1;
+}
+
+
+void hop_stop(void)
+{
+	TIMSK1 &= ~(1 << OCIE1A);
+	slots = 0;
+}
@@ -0,0 +1,24 @@
+/*
+ * fw/hop.h - Channel hopping on a schedule kept in the device
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef HOP_H
+#define	HOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* start from an ATUSB_HOP payload, or just stop if len is 0 */
+bool hop_start(const uint8_t *buf, uint8_t len);
+void hop_stop(void);
+
+#endif /* !HOP_H */
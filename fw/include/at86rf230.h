@@ -58,7 +58,7 @@ enum {
 	REG_FTN_CTRL		= 0x18,	/* 231 only */
 
 	REG_PLL_CF		= 0x1a,
-	REL_PLL_DCU		= 0x1b,
+	REG_PLL_DCU		= 0x1b,
 	REG_PART_NUM		= 0x1c,
 	REG_VERSION_NUM		= 0x1d,
 	REG_MAN_ID_0		= 0x1e,
@@ -34,6 +34,7 @@ enum atusb_requests {
 	ATUSB_GPIO,
 	ATUSB_SLP_TR,
 	ATUSB_GPIO_CLEANUP,
+	ATUSB_BENCH,			/* "make bench" only */
 	ATUSB_REG_WRITE			= 0x20,	/* transceiver group */
 	ATUSB_REG_READ,
 	ATUSB_BUF_WRITE,
@@ -46,8 +47,19 @@ enum atusb_requests {
 	ATUSB_SPI_WRITE2_SYNC,
 	ATUSB_RX_MODE			= 0x40, /* HardMAC group */
 	ATUSB_TX,
+	ATUSB_RX_FILTER,
+	ATUSB_RX_STATS,
+	ATUSB_SCAN,
+	ATUSB_CHAN_CAL,
+	ATUSB_HOP,
+	ATUSB_TEMPLATE,
+	ATUSB_TX_TEMPLATE,
+	ATUSB_TX_AT,
 	ATUSB_EUI64_WRITE		= 0x50, /* Parameter in EEPROM grp */
 	ATUSB_EUI64_READ,
+	ATUSB_FLASH_CRC			= 0x60,	/* boot loader group */
+	ATUSB_FLASH_IMAGE_CRC,
+	ATUSB_FLASH_DELTA,
 };
 
 enum {
@@ -58,6 +70,208 @@ enum {
 	ATUSB_HW_TYPE_HULUSB,	/* Busware HUL USB dongle with at86rf212 */
 };
 
+/*
+ * ATUSB_RX_MODE wValue. Any non-zero value turns reception on. With
+ * ATUSB_RX_MODE_TRAILER, each frame record on EP 1 (length, PSDU, LQI) is
+ * followed by ATUSB_RX_TRAILER_SIZE bytes: the ED level, a flags byte, and
+ * the 48 bit value of timer 1 (8 MHz, little-endian) at TRX_END.
+ */
+#define	ATUSB_RX_MODE_ON		0x01
+#define	ATUSB_RX_MODE_TRAILER		0x02
+
+#define	ATUSB_RX_TRAILER_SIZE		8
+
+#define	ATUSB_RX_FLAG_CRC_VALID		0x80
+#define	ATUSB_RX_FLAG_CRC_KNOWN		0x40	/* not on AT86RF230 */
+#define	ATUSB_RX_FLAG_CHAN_MASK		0x1f	/* PHY_CC_CCA.CHANNEL */
+
+/*
+ * ATUSB_RX_FILTER payload. A frame that fails any enabled test is dropped in
+ * the device and only counted. With ATUSB_RX_FILTER_SHORT and/or _EXT, the
+ * destination or source address has to be one of the enabled addresses. PAN
+ * IDs and addresses are in the byte order of the frame. wLength 0 turns the
+ * filter off.
+ *
+ * ATUSB_RX_FILTER_HW, together with ATUSB_RX_FILTER_PAN, also programs the
+ * transceiver's address filter, so that frames with another destination are
+ * dropped before they reach the MCU. The address tests then only apply to the
+ * destination. It needs an AT86RF231 or AT86RF212 and is ignored otherwise.
+ *
+ * 0	flags (ATUSB_RX_FILTER_*)
+ * 1	frame types to accept, bit n for type n
+ * 2	minimum PSDU length, including the FCS
+ * 3	reserved (0)
+ * 4-5	PAN ID, destination or source
+ * 6-7	short address
+ * 8-15	extended address
+ */
+#define	ATUSB_RX_FILTER_SIZE		16
+
+#define	ATUSB_RX_FILTER_TYPE		0x01
+#define	ATUSB_RX_FILTER_PAN		0x02
+#define	ATUSB_RX_FILTER_SHORT		0x04
+#define	ATUSB_RX_FILTER_EXT		0x08
+#define	ATUSB_RX_FILTER_BROADCAST	0x10	/* 0xffff matches PAN/short */
+#define	ATUSB_RX_FILTER_CRC		0x20	/* not on AT86RF230 */
+#define	ATUSB_RX_FILTER_MIN_LEN		0x40
+#define	ATUSB_RX_FILTER_HW		0x80
+
+/*
+ * ATUSB_RX_STATS: u32 frames received, u32 frames dropped by the filter, and
+ * u16 frames lost to a full ring, since the last ATUSB_RF_RESET
+ */
+#define	ATUSB_RX_STATS_SIZE		10
+
+/*
+ * Telemetry records on EP 2 (bulk IN). The endpoint carries a byte stream of
+ * records, each one being a type byte, a length byte, and that many bytes of
+ * payload. Transfer boundaries carry no meaning. Multi-byte fields are
+ * little-endian.
+ */
+enum atusb_telemetry {
+	ATUSB_TELEM_DROPPED		= 0x01,	/* u16 records lost before this */
+	ATUSB_TELEM_RX_OVERRUN,		/* u16 frames lost to a full ring */
+	ATUSB_TELEM_SCAN,		/* ED statistics of one channel */
+	ATUSB_TELEM_SHADOW,		/* decision of a decide-only attack */
+	ATUSB_TELEM_TX_AT,		/* when an ATUSB_TX_AT frame went out */
+};
+
+/*
+ * ATUSB_TELEM_SHADOW, from firmware built with SHADOW = true, one for each
+ * frame the attack looked at. The attack decides as usual, but doesn't act,
+ * and the frame is captured normally.
+ *
+ * 0-5	timer 1 when the attack was called, at RX_START
+ * 6	attack ID (ATTACKID of the build)
+ * 7	ATUSB_SHADOW_* of what the attack tried to do, 0 if nothing
+ * 8-9	source line of the attack's last spi_end() before it returned or
+ *	tried to act, which tells the exit branch
+ * 10-11	CPU cycles from the call to the decision (timer 1 ticks)
+ * 12-	up to ATUSB_SHADOW_HDR bytes the attack had read from the frame
+ *	buffer by then, starting with the PHR
+ */
+#define	ATUSB_SHADOW_REC_SIZE		12	/* without header bytes */
+#define	ATUSB_SHADOW_HDR		16
+
+#define	ATUSB_SHADOW_TX			0x01	/* frame buffer write or SLP_TR */
+#define	ATUSB_SHADOW_STATE		0x02	/* TRX_STATE change */
+
+/*
+ * ATUSB_SCAN wValue selects the channels, bit n for channel 11+n, or channel
+ * n on the AT86RF212, and wIndex is the number of ED samples to take on each
+ * channel. The device sweeps the channels until ATUSB_SCAN with wValue 0,
+ * ATUSB_RX_MODE, or ATUSB_RF_RESET, and reports each channel in an
+ * ATUSB_TELEM_SCAN record:
+ *
+ * 0	channel
+ * 1-3	minimum, maximum, and mean PHY_ED_LEVEL
+ * 4-5	number of samples
+ * 6-	ATUSB_SCAN_BINS u16 counts of PHY_ED_LEVEL >> ATUSB_SCAN_BIN_SHIFT,
+ *	the last bin also counting all higher levels
+ */
+#define	ATUSB_SCAN_BINS			8
+#define	ATUSB_SCAN_BIN_SHIFT		3
+#define	ATUSB_SCAN_REC_SIZE		(6+2*ATUSB_SCAN_BINS)
+
+/*
+ * ATUSB_CHAN_CAL calibrates the PLL on the channels in wValue, with the same
+ * bits as ATUSB_SCAN, and measures how long each one takes to lock when the
+ * device switches to it. It returns one byte per channel, starting with the
+ * lowest: the slowest lock time seen in microseconds, or one of the values
+ * below. wValue 0 just returns the results of earlier calibrations. Channel
+ * changes made by the device itself then wait for the measured time.
+ */
+#define	ATUSB_CHAN_UNKNOWN		0x00	/* not calibrated */
+#define	ATUSB_CHAN_FAILED		0xff	/* no PLL lock or calibration */
+
+/*
+ * ATUSB_HOP payload: up to ATUSB_HOP_SLOTS entries of a channel followed by
+ * the time to stay there in microseconds (u24, at least ATUSB_HOP_MIN_DWELL).
+ * The device tunes to the first channel right away and cycles through the
+ * list until ATUSB_HOP with wLength 0, ATUSB_RX_MODE off, or ATUSB_RF_RESET.
+ * A hop that is due while a frame is coming in waits for the frame, so the
+ * channel in the record trailer is always the one the frame came in on. The
+ * next dwell time is shortened by the delay to keep the schedule. Each
+ * channel is tuned ahead of its slot by its PLL lock time, the one measured
+ * by ATUSB_CHAN_CAL or else 200 us, so that the slot starts locked.
+ */
+#define	ATUSB_HOP_SLOTS			16
+#define	ATUSB_HOP_ENTRY_SIZE		4
+#define	ATUSB_HOP_MIN_DWELL		100
+
+/*
+ * ATUSB_TEMPLATE stores a PSDU without FCS as template wValue, of
+ * ATUSB_TEMPLATE_SLOTS, in device RAM, or deletes it if wLength is 0. It
+ * fails if the templates wouldn't fit. They survive ATUSB_RF_RESET.
+ *
+ * ATUSB_TX_TEMPLATE sends template wValue like ATUSB_TX, acknowledging with
+ * wIndex on EP 1, after applying the patches in its payload: runs of an
+ * offset into the PSDU, a length, and that many bytes. Patches stay in the
+ * template. If the transceiver's frame buffer still holds the template from
+ * the last ATUSB_TX_TEMPLATE, only the patched bytes are written to it. This
+ * needs IRQ_RX_START in IRQ_MASK, so that the device sees every reception. A
+ * patch beyond the end of the template cancels the transmission.
+ */
+#define	ATUSB_TEMPLATE_SLOTS		8
+
+/*
+ * ATUSB_TX_AT payload: the 48 bit value of timer 1 (as in ATUSB_TIMER and
+ * the RX trailer) at which to transmit, followed by the PSDU without FCS.
+ * The device loads the frame right away and keeps the transceiver in
+ * TX_ARET_ON, not receiving, until it raises SLP_TR at that time. A time
+ * that has already passed sends at once. The target must be less than
+ * 2^31 ticks (about 268 s) ahead. Only one frame can be pending, and
+ * ATUSB_RX_MODE or ATUSB_RF_RESET drop it without acknowledgement.
+ *
+ * The device gets ready 100 us before the target and then raises SLP_TR
+ * within a few cycles of it. If another interrupt handler is still running
+ * at that point and keeps running past the target, the frame goes out late.
+ * EP0 requests that work on the transceiver, such as ATUSB_CHAN_CAL and
+ * ATUSB_BENCH, can take milliseconds, so the host shouldn't issue them while
+ * a frame is pending. The record tells when the frame really went out.
+ *
+ * As with ATUSB_TX, wIndex comes back on EP 1 when the transmission is
+ * done. The ATUSB_TELEM_TX_AT record is sent when it begins:
+ *
+ * 0	wIndex of the request
+ * 1-6	requested timer 1
+ * 7-12	timer 1 when SLP_TR was raised
+ */
+#define	ATUSB_TX_AT_TIME_SIZE		6
+#define	ATUSB_TX_AT_REC_SIZE		13
+
+/*
+ * ATUSB_BENCH, only in firmware built with "make bench", times primitive
+ * wValue ATUSB_BENCH_RUNS times with timer 1, which counts CPU cycles.
+ * wIndex is the number of bytes for the primitives that take one, from 1 to
+ * MAX_PSDU. Reception is turned off, the transceiver is kept in PLL_ON
+ * while the request runs, and it is left in TRX_OFF with the frame buffer
+ * overwritten. The result, all u16:
+ *
+ * 0-1	fewest cycles
+ * 2-3	mean cycles, rounded down
+ * 4-5	most cycles
+ * 6-7	runs that read back wrong data or didn't reach the expected state
+ *
+ * The cost of reading the timer is subtracted, except from
+ * ATUSB_BENCH_NONE, which measures it.
+ */
+enum atusb_bench {
+	ATUSB_BENCH_NONE,		/* reading timer 1 twice */
+	ATUSB_BENCH_SPI_IO,		/* spi_io, with nSS high */
+	ATUSB_BENCH_SPI_BLOCK,		/* spi_recv_block of #bytes, nSS high */
+	ATUSB_BENCH_REG_READ,		/* reg_read of TRX_STATUS */
+	ATUSB_BENCH_STATE,		/* PLL_ON to RX_ON and back */
+	ATUSB_BENCH_BUF_WRITE,		/* frame buffer write of #bytes */
+	ATUSB_BENCH_BUF_READ,		/* frame buffer read of #bytes */
+	ATUSB_BENCH_SRAM_READ,		/* SRAM_READ of a random byte */
+	ATUSB_BENCH_SLP_TR,		/* SLP_TR until BUSY_TX, sends #bytes */
+	ATUSB_BENCH_PRIMITIVES
+};
+
+#define	ATUSB_BENCH_RUNS		64
+#define	ATUSB_BENCH_REC_SIZE		8
+
 /*
  * Direction	bRequest		wValue		wIndex	wLength
  *
@@ -72,6 +286,7 @@ enum {
  * ->host	ATUSB_GPIO		dir+data	mask+p#	3
  * host->	ATUSB_SLP_TR		-		-	0
  * host->	ATUSB_GPIO_CLEANUP	-		-	0
+ * ->host	ATUSB_BENCH		primitive	#bytes	#bytes (8)
  *
  * host->	ATUSB_REG_WRITE		value		addr	0
  * ->host	ATUSB_REG_READ		-		addr	1
@@ -85,10 +300,30 @@ enum {
  * ->host	ATUSB_SPI_READ2		byte0		byte1	#bytes
  * ->host	ATUSB_SPI_WRITE2_SYNC	byte0		byte1	0/1
  *
- * host->	ATUSB_RX_MODE		on		-	0
+ * host->	ATUSB_RX_MODE		on+flags	-	0
  * host->	ATUSB_TX		flags		ack_seq	#bytes
+ * host->	ATUSB_RX_FILTER		-		-	#bytes (0 or 16)
+ * ->host	ATUSB_RX_STATS		-		-	#bytes (10)
+ * host->	ATUSB_SCAN		channels	samples	0
+ * ->host	ATUSB_CHAN_CAL		channels	-	#bytes (16, 11)
+ * host->	ATUSB_HOP		-		-	#bytes (4*n)
+ * host->	ATUSB_TEMPLATE		slot		-	#bytes
+ * host->	ATUSB_TX_TEMPLATE	slot		ack_seq	#bytes
+ * host->	ATUSB_TX_AT		-		ack_seq	#bytes
  * host->	ATUSB_EUI64_WRITE	-		-	#bytes (8)
  * ->host	ATUSB_EUI64_READ	-		-	#bytes (8)
+ *
+ * ->host	ATUSB_FLASH_CRC		-		page	2*#pages
+ * ->host	ATUSB_FLASH_IMAGE_CRC	len_lo		len_hi	2
+ * host->	ATUSB_FLASH_DELTA	-		-	0
+ *
+ * The boot loader group is only understood by the DFU boot loader. A "page"
+ * is one DFU block (wTransferSize bytes). ATUSB_FLASH_DELTA, sent in dfuIDLE,
+ * makes the next download a delta download: DFU_DNLOAD block n is then
+ * written to page n, so that a host can skip blocks that are already in
+ * flash. Otherwise, the first block goes to page 0, whatever its number. The
+ * CRCs are CRC-16/CCITT (reflected polynomial 0x8408, initial value 0xffff),
+ * sent little-endian.
  */
 
 #define ATUSB_REQ_FROM_DEV	(USB_TYPE_VENDOR | USB_DIR_IN)
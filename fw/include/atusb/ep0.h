@@ -27,10 +27,20 @@
  * 	Support to run the firmware on Atmel Raven USB dongles
  * 	Remove FCS frame check from firmware and leave it to the driver
  * 	Use extended operation mode for TX for automatic ACK handling
+ * 0.4	Telemetry record stream on EP 2
+ * 	ATUSB_RX_MODE_TRAILER for ED, CRC status, channel, and time of frames
+ * 	ATUSB_RX_FILTER and ATUSB_RX_STATS
+ * 	ATUSB_SCAN, with results in ATUSB_TELEM_SCAN records
+ * 	ATUSB_CHAN_CAL
+ * 	ATUSB_HOP
+ * 	ATUSB_TELEM_SHADOW records from decide-only attacks
+ * 	ATUSB_TEMPLATE and ATUSB_TX_TEMPLATE
+ * 	ATUSB_TX_AT, with ATUSB_TELEM_TX_AT records
+ * 	ATUSB_BENCH in benchmark builds
  */
 
 #define EP0ATUSB_MAJOR	0	/* EP0 protocol, major revision */
-#define EP0ATUSB_MINOR	3	/* EP0 protocol, minor revision */
+#define EP0ATUSB_MINOR	4	/* EP0 protocol, minor revision */
 
 
 /*
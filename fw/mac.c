@@ -17,26 +17,63 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#ifdef TX_AT
+#include <avr/io.h>
+#endif
+
 #include "usb.h"
 
 #include "at86rf230.h"
 #include "spi.h"
+#include "hal.h"
 #include "board.h"
 #include "attack.h"
+#include "filter.h"
+#include "telemetry.h"
+#ifdef SCAN
+#include "scan.h"
+#endif
+#ifdef HOP
+#include "hop.h"
+#endif
+#ifdef SHADOW
+#include "shadow.h"
+#endif
+#ifdef TEMPLATE
+#include "template.h"
+#endif
+#ifdef TX_AT
+#include "timer.h"
+#endif
 #include "mac.h"
 
-#define	RX_BUFS	3
+#define	RX_BUFS	BOARD_RX_BUFS
+#define	RX_TRAILER	ATUSB_RX_TRAILER_SIZE
 
+#ifdef TX_AT
+#define	TX_BUF		(ATUSB_TX_AT_TIME_SIZE+MAX_PSDU-2) /* time, PSDU */
+#else
+#define	TX_BUF		MAX_PSDU
+#endif
 
-bool (*mac_irq)(void) = NULL;
 
+bool mac_irq_on = 0;
+#ifndef SHADOW
+bool attack_tx_more = 0;
+#endif
 
-static uint8_t rx_buf[RX_BUFS][MAX_PSDU+2]; /* PHDR+payload+LQ */
-static uint8_t tx_buf[MAX_PSDU];
+
+static uint8_t rx_buf[RX_BUFS][MAX_PSDU+2+RX_TRAILER]; /* PHDR+payload+LQ */
+static uint8_t rx_size[RX_BUFS];	/* bytes to send, with trailer */
+static bool rx_trailer = 0;
+static uint8_t tx_buf[TX_BUF];
 static uint8_t tx_size = 0;
 static bool txing = 0;
 static bool queued_tx_ack = 0;
 static uint8_t next_seq, this_seq, queued_seq;
+static uint16_t rx_overruns = 0;
+static uint32_t rx_frames = 0;
+static uint32_t rx_filtered = 0;
 
 
 /* ----- Receive buffer management ----------------------------------------- */
@@ -45,9 +82,16 @@ static uint8_t next_seq, this_seq, queued_seq;
 static uint8_t rx_in = 0, rx_out = 0;
 
 
+static inline uint8_t next_index(uint8_t index)
+{
+	/* avoid the modulo, which is a library call on AVR */
+	return index == RX_BUFS-1 ? 0 : index+1;
+}
+
+
 static inline void next_buf(uint8_t *index)
 {
-	*index = (*index+1) % RX_BUFS;
+	*index = next_index(*index);
 }
 
 
@@ -62,15 +106,20 @@ static void usb_next(void)
 {
 	const uint8_t *buf;
 
-	if (rx_in != rx_out) {
-		buf = rx_buf[rx_out];
-		led(1);
-		usb_send(&eps[1], buf, buf[0]+2, rx_done, NULL);
-	}
-
+	/*
+	 * EP1 only takes one transfer at a time. The host's TX path waits for
+	 * the acknowledgement, so let it overtake a backlog of frames.
+	 */
 	if (queued_tx_ack) {
 		usb_send(&eps[1], &queued_seq, 1, tx_ack_done, NULL);
 		queued_tx_ack = 0;	
+		return;
+	}
+
+	if (rx_in != rx_out) {
+		buf = rx_buf[rx_out];
+		led(1);
+		usb_send(&eps[1], buf, rx_size[rx_out], rx_done, NULL);
 	}
 }
 
@@ -92,25 +141,60 @@ static void rx_done(void *user)
 }
 
 
+static void add_trailer(uint8_t *p, uint8_t status, uint64_t t)
+{
+	uint8_t i;
+
+	*p++ = reg_read(REG_PHY_ED_LEVEL);
+	*p = reg_read(REG_PHY_CC_CCA) & CHANNEL_MASK;
+#ifndef AT86RF230
+	/* the SPI status byte is PHY_RSSI, see mac_reset */
+	*p |= ATUSB_RX_FLAG_CRC_KNOWN;
+	if (status & RX_CRC_VALID)
+		*p |= ATUSB_RX_FLAG_CRC_VALID;
+#endif
+	p++;
+	for (i = 0; i != 6; i++) {
+		*p++ = t;
+		t >>= 8;
+	}
+}
+
+
 static void receive_frame(void)
 {
-	uint8_t size;
+	uint8_t status, size, got = 0;
 	uint8_t *buf;
+	uint64_t t = 0;
+
+	if (rx_trailer)
+		t = timer_read();
 
-	spi_begin();
-	spi_io(AT86RF230_BUF_READ);
+	hal_spi_begin();
+	status = hal_spi_io(AT86RF230_BUF_READ);
 
-	size = spi_recv();
+	size = hal_spi_io(0);
 	if (!size || (size & 0x80)) {
-		spi_end();
+		hal_spi_end();
 		return;
 	}
 
+	rx_frames++;
 	buf = rx_buf[rx_in];
-	spi_recv_block(buf+1, size+1);
-	spi_end();
+	if (filter_on && !filter_frame(status, buf+1, size, &got)) {
+		hal_spi_end();
+		rx_filtered++;
+		return;
+	}
+	spi_recv_block(buf+1+got, size+1-got);
+	hal_spi_end();
 
 	buf[0] = size;
+	rx_size[rx_in] = size+2;
+	if (rx_trailer) {
+		add_trailer(buf+size+2, status, t);
+		rx_size[rx_in] += RX_TRAILER;
+	}
 	next_buf(&rx_in);
 
 	if (eps[1].state == EP_IDLE)
@@ -118,18 +202,32 @@ static void receive_frame(void)
 }
 
 
-static bool handle_irq(void)
+bool mac_irq(uint8_t irq)
 {
-	uint8_t irq;
-
-	irq = reg_read(REG_IRQ_STATUS);
+#ifdef TEMPLATE
+	/* anything but the end of our own transmission may change the buffer */
+	if (!txing || irq != IRQ_TRX_END)
+		template_forget();
+#endif
 	if (irq == IRQ_RX_START)
+#ifdef SHADOW
+		if (shadow_attack())
+#else
 		if (attack())
+#endif
 			return 1;
 
 	if (!(irq & IRQ_TRX_END))
 		return 1;
 
+#ifndef SHADOW
+	/* an attack's own frame, with more of the sequence to come */
+	if (attack_tx_more) {
+		attack_tx_more = 0;
+		return 1;
+	}
+#endif
+
 	if (txing) {
 		if (eps[1].state == EP_IDLE) {
 			usb_send(&eps[1], &this_seq, 1, tx_ack_done, NULL);
@@ -141,37 +239,92 @@ static bool handle_irq(void)
 		return 1;
 	}
 
-	/* likely */
-	if (eps[1].state == EP_IDLE || rx_in != rx_out)
+	/*
+	 * If the ring is full, the frame is dropped: the next reception
+	 * overwrites it in the transceiver, and we only count it and report
+	 * the count as telemetry. The slot at rx_out may still be in flight
+	 * on EP1.
+	 */
+	if (next_index(rx_in) != rx_out) {	/* likely */
 		receive_frame();
+	} else {
+		rx_overruns++;
+		telemetry_send(ATUSB_TELEM_RX_OVERRUN, &rx_overruns,
+		    sizeof(rx_overruns));
+	}
 
 	return 1;
 }
 
 
+static void handle_irq(void)
+{
+	mac_irq(reg_read(REG_IRQ_STATUS));
+}
+
+
 /* ----- TX/RX ------------------------------------------------------------- */
 
 
+#ifdef TX_AT
+
+static struct timer tx_at_timer;	/* queued while a frame waits */
+
+#endif
+
+
+static bool tx_pending(void)
+{
+#ifdef TX_AT
+	return tx_at_timer.queued;
+#else
+	return 0;
+#endif
+}
+
+
+static void tx_drop(void)
+{
+#ifdef TX_AT
+	timer_cancel(&tx_at_timer);
+#endif
+}
+
+
 bool mac_rx(int on)
 {
+#ifdef SCAN
+	scan_stop();
+#endif
+#ifdef TEMPLATE
+	/* scans receive with all interrupts masked */
+	template_forget();
+#endif
+	tx_drop();
 	if (on) {
-		mac_irq = handle_irq;
+		rx_trailer = on & ATUSB_RX_MODE_TRAILER;
+		mac_irq_on = 1;
 		reg_read(REG_IRQ_STATUS);
 		change_state(TRX_CMD_RX_AACK_ON);
 	} else {
-		mac_irq = NULL;
+#ifdef HOP
+		hop_stop();
+#endif
+		mac_irq_on = 0;
 		change_state(TRX_CMD_FORCE_TRX_OFF);
 		txing = 0;
+#ifndef SHADOW
+		attack_tx_more = 0;
+#endif
 	}
 	return 1;
 }
 
 
-static void do_tx(void *user)
+static bool tx_prepare(void)
 {
 	uint16_t timeout = 0xffff;
 	uint8_t status;
-	uint8_t i;
 
 	/*
 	 * If we time out here, the host driver will time out waiting for the
@@ -179,7 +332,7 @@ static void do_tx(void *user)
 	 */
 	do {
 		if (!--timeout)
-			return;
+			return 0;
 		status = reg_read(REG_TRX_STATUS) & TRX_STATUS_MASK;
 	}
 	while (status != TRX_STATUS_RX_ON && status != TRX_STATUS_RX_AACK_ON);
@@ -209,18 +362,29 @@ static void do_tx(void *user)
 #endif
 
 	handle_irq();
+	return 1;
+}
 
-	spi_begin();
-	spi_send(AT86RF230_BUF_WRITE);
-	spi_send(tx_size+2); /* CRC */
-	for (i = 0; i != tx_size; i++)
-		spi_send(tx_buf[i]);
-	spi_end();
 
-	change_state(TRX_STATUS_TX_ARET_ON);
+static void write_frame(const uint8_t *buf, uint8_t len)
+{
+	uint8_t i;
+
+#ifdef TEMPLATE
+	template_forget();
+#endif
+	hal_spi_begin();
+	hal_spi_io(AT86RF230_BUF_WRITE);
+	hal_spi_io(len+2); /* CRC */
+	for (i = 0; i != len; i++)
+		hal_spi_io(buf[i]);
+	hal_spi_end();
+}
 
-	slp_tr();
 
+/* call right after SLP_TR */
+static void tx_started(void)
+{
 	txing = 1;
 	this_seq = next_seq;
 
@@ -233,9 +397,26 @@ static void do_tx(void *user)
 }
 
 
+static void tx_send(void)
+{
+	change_state(TRX_STATUS_TX_ARET_ON);
+	slp_tr();
+	tx_started();
+}
+
+
+static void do_tx(void *user)
+{
+	if (!tx_prepare())
+		return;
+	write_frame(tx_buf, tx_size);
+	tx_send();
+}
+
+
 bool mac_tx(uint16_t flags, uint8_t seq, uint16_t len)
 {
-	if (len > MAX_PSDU)
+	if (len > MAX_PSDU || tx_pending())
 		return 0;
 	tx_size = len;
 	next_seq = seq;
@@ -244,13 +425,168 @@ bool mac_tx(uint16_t flags, uint8_t seq, uint16_t len)
 }
 
 
+#ifdef TEMPLATE
+
+static uint8_t tx_slot;
+
+
+static void do_tx_template(void *user)
+{
+	if (!tx_prepare())
+		return;
+	if (!template_load(tx_slot, tx_buf, tx_size)) {
+		/* bad patch: nothing was written, the host times out */
+		change_state(TRX_CMD_RX_AACK_ON);
+		return;
+	}
+	tx_send();
+}
+
+
+bool mac_tx_template(uint8_t slot, uint8_t seq, uint16_t len)
+{
+	if (len > MAX_PSDU || !template_valid(slot) || tx_pending())
+		return 0;
+	tx_slot = slot;
+	tx_size = len;
+	next_seq = seq;
+	if (len)
+		usb_recv(&eps[0], tx_buf, len, do_tx_template, NULL);
+	else
+		do_tx_template(NULL);
+	return 1;
+}
+
+#endif /* TEMPLATE */
+
+
+#ifdef TX_AT
+
+/*
+ * The timer service can't promise to call us on time, so it calls us
+ * TX_AT_LEAD early, and we spin on the counter for the rest. We run with
+ * interrupts disabled, so nothing can get in between. An interrupt that is
+ * already running when the callback becomes due and takes longer than
+ * TX_AT_LEAD still makes us late. Long EP0 requests such as ATUSB_CHAN_CAL
+ * can do that. We then send at once, and the record shows the actual time.
+ */
+
+#define	TX_AT_LEAD	TIMER_US(100)
+
+
+static uint64_t tx_at;
+
+
+static void put_time(uint8_t *p, uint64_t t)
+{
+	uint8_t i;
+
+	for (i = 0; i != ATUSB_TX_AT_TIME_SIZE; i++) {
+		*p++ = t;
+		t >>= 8;
+	}
+}
+
+
+static void tx_at_fire(void *user)
+{
+	uint8_t rec[ATUSB_TX_AT_REC_SIZE];
+	uint64_t now;
+	uint16_t t;
+
+	now = timer_read();
+	if ((int32_t) ((uint32_t) tx_at-(uint32_t) now) > 0) {
+		do t = TCNT1;
+		while ((int16_t) (t-(uint16_t) tx_at) < 0);
+		hal_slp_tr();
+		now = tx_at+(uint16_t) (t-(uint16_t) tx_at);
+	} else {
+		hal_slp_tr();
+		now = timer_read();
+	}
+	tx_started();
+
+	rec[0] = this_seq;
+	put_time(rec+1, tx_at);
+	put_time(rec+1+ATUSB_TX_AT_TIME_SIZE, now);
+	telemetry_send(ATUSB_TELEM_TX_AT, rec, sizeof(rec));
+}
+
+
+static void do_tx_at(void *user)
+{
+	int32_t wait;
+	uint8_t i;
+
+	tx_at = 0;
+	for (i = ATUSB_TX_AT_TIME_SIZE; i; i--)
+		tx_at = tx_at << 8 | tx_buf[i-1];
+
+	if (!tx_prepare())
+		return;
+	write_frame(tx_buf+ATUSB_TX_AT_TIME_SIZE,
+	    tx_size-ATUSB_TX_AT_TIME_SIZE);
+	change_state(TRX_STATUS_TX_ARET_ON);
+
+	wait = (uint32_t) tx_at-TX_AT_LEAD-(uint32_t) timer_read();
+	timer_start(&tx_at_timer, wait < 0 ? 0 : wait, 0, tx_at_fire, NULL);
+}
+
+
+bool mac_tx_at(uint8_t seq, uint16_t len)
+{
+	if (len < ATUSB_TX_AT_TIME_SIZE || len > TX_BUF || tx_pending())
+		return 0;
+	tx_size = len;
+	next_seq = seq;
+	usb_recv(&eps[0], tx_buf, len, do_tx_at, NULL);
+	return 1;
+}
+
+#endif /* TX_AT */
+
+
+static uint8_t put_le(uint8_t *p, uint32_t v, uint8_t bytes)
+{
+	uint8_t i;
+
+	for (i = 0; i != bytes; i++) {
+		*p++ = v;
+		v >>= 8;
+	}
+	return bytes;
+}
+
+
+uint8_t mac_stats(uint8_t *buf)
+{
+	uint8_t *p = buf;
+
+	p += put_le(p, rx_frames, 4);
+	p += put_le(p, rx_filtered, 4);
+	p += put_le(p, rx_overruns, 2);
+	return p-buf;
+}
+
+
 void mac_reset(void)
 {
-	mac_irq = NULL;
+	tx_drop();
+	mac_irq_on = 0;
 	txing = 0;
+#ifndef SHADOW
+	attack_tx_more = 0;
+#endif
 	queued_tx_ack = 0;
+	rx_trailer = 0;
 	rx_in = rx_out = 0;
+	rx_overruns = 0;
+	rx_frames = rx_filtered = 0;
+	filter_reset();
 	next_seq = this_seq = queued_seq = 0;
+#ifdef TEMPLATE
+	template_forget();
+#endif
 
 	/* enable CRC and PHY_RSSI (with RX_CRC_VALID) in SPI status return */
 	reg_write(REG_TRX_CTRL_1,
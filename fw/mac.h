@@ -17,10 +17,21 @@
 #include <stdint.h>
 
 
-extern bool (*mac_irq)(void);
+/* the HardMAC handles the transceiver's interrupts */
+extern bool mac_irq_on;
+
+/* called from the interrupt handler, with the IRQ_STATUS it has read */
+bool mac_irq(uint8_t irq);
 
 bool mac_rx(int on);
 bool mac_tx(uint16_t flags, uint8_t seq, uint16_t len);
+#ifdef TEMPLATE
+bool mac_tx_template(uint8_t slot, uint8_t seq, uint16_t len);
+#endif
+#ifdef TX_AT
+bool mac_tx_at(uint8_t seq, uint16_t len);
+#endif
+uint8_t mac_stats(uint8_t *buf);
 void mac_reset(void);
 
 #endif /* !MAC_H */
@@ -0,0 +1,197 @@
+/*
+ * fw/scan.c - Energy detection scan over a list of channels
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The scan runs from timer 1's compare B interrupt, which alternates between
+ * reading the result of one ED measurement and starting the next, so the
+ * sample rate is set by the measurement time of the transceiver. After
+ * "dwell" samples on a channel, its statistics go out as one telemetry
+ * record and the scan tunes to the next channel, waiting as long as
+ * chan_switch says. Only the statistics of the current channel are kept.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "at86rf230.h"
+#include "board.h"
+#include "atusb/atusb.h"
+#include "mac.h"
+#include "telemetry.h"
+#include "timer.h"
+#include "chan.h"
+#include "scan.h"
+
+
+#define	RETRY_TICKS	TIMER_US(20)		/* measurement not done yet */
+
+#ifdef AT86RF212
+#define	ED_TICKS	TIMER_US(420)	/* 8 symbols of BPSK-20 */
+#else
+#define	ED_TICKS	TIMER_US(140)	/* 8 symbols */
+#endif
+
+#define	ED_BUSY		0xff			/* PHY_ED_LEVEL, in progress */
+
+
+static uint16_t channels;
+static uint16_t dwell;
+static uint8_t irq_mask;			/* to restore when done */
+static uint8_t chan;				/* bit in "channels" */
+static bool settling;
+
+static uint16_t samples;
+static uint8_t ed_min, ed_max;
+static uint32_t ed_sum;
+static uint16_t hist[ATUSB_SCAN_BINS];
+
+
+static void arm(uint16_t ticks)
+{
+	OCR1B = TCNT1+ticks;
+	TIFR1 = 1 << OCF1B;
+	TIMSK1 |= 1 << OCIE1B;
+}
+
+
+static void start_ed(void)
+{
+#ifdef AT86RF230
+	/* the AT86RF230 measures ED as part of CCA, which is in mode 1 */
+	reg_write(REG_PHY_CC_CCA, reg_read(REG_PHY_CC_CCA) | CCA_REQUEST);
+#else
+	reg_write(REG_PHY_ED_LEVEL, 0);
+#endif
+}
+
+
+static void tune(void)
+{
+	uint16_t settle;
+	uint8_t i;
+
+	/* find the next channel, wrapping around to start a new sweep */
+	for (i = 0; i != 16; i++) {
+		chan = chan == 15 ? 0 : chan+1;
+		if (channels & 1 << chan)
+			break;
+	}
+	settle = chan_switch(CHAN_FIRST+chan);
+
+	samples = 0;
+	ed_min = 0xff;
+	ed_max = 0;
+	ed_sum = 0;
+	for (i = 0; i != ATUSB_SCAN_BINS; i++)
+		hist[i] = 0;
+
+	settling = 1;
+	arm(settle);
+}
+
+
+static void report(void)
+{
+	uint8_t buf[ATUSB_SCAN_REC_SIZE];
+	uint8_t *p = buf;
+	uint8_t i;
+
+	*p++ = CHAN_FIRST+chan;
+	*p++ = ed_min;
+	*p++ = ed_max;
+	*p++ = ed_sum/samples;
+	*p++ = samples;
+	*p++ = samples >> 8;
+	for (i = 0; i != ATUSB_SCAN_BINS; i++) {
+		*p++ = hist[i];
+		*p++ = hist[i] >> 8;
+	}
+	telemetry_send(ATUSB_TELEM_SCAN, buf, sizeof(buf));
+}
+
+
+static void sample(uint8_t ed)
+{
+	uint8_t bin;
+
+	samples++;
+	if (ed < ed_min)
+		ed_min = ed;
+	if (ed > ed_max)
+		ed_max = ed;
+	ed_sum += ed;
+	bin = ed >> ATUSB_SCAN_BIN_SHIFT;
+	hist[bin < ATUSB_SCAN_BINS ? bin : ATUSB_SCAN_BINS-1]++;
+}
+
+
+ISR(TIMER1_COMPB_vect)
+{
+	uint8_t ed;
+
+	if (settling) {
+		settling = 0;
+	} else {
+		ed = reg_read(REG_PHY_ED_LEVEL);
+		if (ed == ED_BUSY) {
+			arm(RETRY_TICKS);
+			return;
+		}
+		sample(ed);
+		if (samples == dwell) {
+			report();
+			tune();
+			return;
+		}
+	}
+	start_ed();
+	arm(ED_TICKS);
+}
+
+
+bool scan_start(uint16_t mask, uint16_t n)
+{
+	scan_stop();
+	if (!mask || !n)
+		return 1;
+#ifdef AT86RF212
+	if (mask & ~((1 << 11)-1))
+		return 0;
+#endif
+	mac_rx(0);
+
+	/* the host gets no frames or interrupts while we scan */
+	irq_mask = reg_read(REG_IRQ_MASK);
+	reg_write(REG_IRQ_MASK, 0);
+	reg_read(REG_IRQ_STATUS);
+
+	channels = mask;
+	dwell = n;
+	chan = 15;
+	change_state(TRX_CMD_RX_ON);
+	tune();
+	return 1;
+}
+
+
+void scan_stop(void)
+{
+	if (!channels)
+		return;
+	TIMSK1 &= ~(1 << OCIE1B);
+	channels = 0;
+	change_state(TRX_CMD_FORCE_TRX_OFF);
+	reg_write(REG_IRQ_MASK, irq_mask);
+}
@@ -0,0 +1,24 @@
+/*
+ * fw/scan.h - Energy detection scan over a list of channels
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SCAN_H
+#define	SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* sweep the channels in "mask" until stopped, "dwell" samples per channel */
+bool scan_start(uint16_t mask, uint16_t dwell);
+void scan_stop(void);
+
+#endif /* !SCAN_H */
@@ -0,0 +1,180 @@
+/*
+ * fw/shadow.c - Run the attack up to its decision, without acting on it
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * With SHADOW, attack.h redirects the attack's SPI transfers, state changes,
+ * and SLP_TR pulses to the functions below. Reads go through and are
+ * remembered, while anything that would make the transceiver leave
+ * reception or write the frame buffer is dropped and only noted. The frame
+ * therefore stays in the transceiver and is captured as usual.
+ *
+ * Each call of attack() yields one ATUSB_TELEM_SHADOW record. The exit
+ * branch is told by the source line of the last spi_end before the attack
+ * returned or tried to act, which every branch of the attacks has.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "at86rf230.h"
+#include "spi.h"
+#include "board.h"
+#include "atusb/atusb.h"
+#include "attack.h"
+#include "telemetry.h"
+#include "shadow.h"
+
+
+enum xfer {
+	XFER_IDLE,
+	XFER_PENDING,		/* spi_begin, but no command yet */
+	XFER_ON,
+	XFER_DROPPED,
+};
+
+
+static bool active = 0;		/* inside attack() */
+static enum xfer state = XFER_IDLE;
+static bool reading;		/* frame buffer read in progress */
+
+static uint8_t rec[ATUSB_SHADOW_REC_SIZE+ATUSB_SHADOW_HDR];
+static uint8_t hdr_len;
+static uint8_t flags;
+static uint16_t line;
+static uint16_t t0, cycles;
+
+
+/* ----- Decision ---------------------------------------------------------- */
+
+
+static void act(uint8_t flag)
+{
+	if (!active)
+		return;
+	if (!flags)
+		cycles = TCNT1-t0;
+	flags |= flag;
+}
+
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+
+bool shadow_attack(void)
+{
+	uint64_t t;
+	bool res;
+	uint8_t i;
+
+	t = timer_read();
+	t0 = t;
+	hdr_len = 0;
+	flags = 0;
+	line = 0;
+	active = 1;
+
+	res = attack();
+
+	active = 0;
+	if (!flags)
+		cycles = TCNT1-t0;
+	for (i = 0; i != 6; i++) {
+		rec[i] = t;
+		t >>= 8;
+	}
+	rec[6] = ATTACK_ID;
+	rec[7] = flags;
+	put_u16(rec+8, line);
+	put_u16(rec+10, cycles);
+	telemetry_send(ATUSB_TELEM_SHADOW, rec,
+	    ATUSB_SHADOW_REC_SIZE+hdr_len);
+	return res;
+}
+
+
+/* ----- Stand-ins for the attack ------------------------------------------ */
+
+
+void shadow_spi_begin(void)
+{
+	state = XFER_PENDING;
+}
+
+
+uint8_t shadow_spi_io(uint8_t v)
+{
+	uint8_t res;
+
+	switch (state) {
+	case XFER_PENDING:
+		if (v == AT86RF230_BUF_WRITE || v == AT86RF230_SRAM_WRITE) {
+			act(ATUSB_SHADOW_TX);
+			state = XFER_DROPPED;
+			return 0;
+		}
+		if (v == (AT86RF230_REG_WRITE | REG_TRX_STATE)) {
+			act(ATUSB_SHADOW_STATE);
+			state = XFER_DROPPED;
+			return 0;
+		}
+		spi_begin();
+		state = XFER_ON;
+		reading = v == AT86RF230_BUF_READ;
+		return spi_io(v);
+	case XFER_DROPPED:
+		return 0;
+	default:
+		res = spi_io(v);
+		if (reading && active && !flags &&
+		    hdr_len != ATUSB_SHADOW_HDR)
+			rec[ATUSB_SHADOW_REC_SIZE+hdr_len++] = res;
+		return res;
+	}
+}
+
+
+void shadow_spi_end(uint16_t where)
+{
+	if (state == XFER_ON)
+		spi_end();
+	state = XFER_IDLE;
+	reading = 0;
+	if (active && !flags)
+		line = where;
+}
+
+
+void shadow_reg_write(uint8_t reg, uint8_t value)
+{
+	if (reg == REG_TRX_STATE)
+		act(ATUSB_SHADOW_STATE);
+	else
+		reg_write(reg, value);
+}
+
+
+void shadow_change_state(uint8_t new)
+{
+	act(ATUSB_SHADOW_STATE);
+}
+
+
+void shadow_slp_tr(void)
+{
+	act(ATUSB_SHADOW_TX);
+}
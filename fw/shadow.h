@@ -0,0 +1,31 @@
+/*
+ * fw/shadow.h - Run the attack up to its decision, without acting on it
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SHADOW_H
+#define	SHADOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* call attack() and report what it decided, for mac.c */
+bool shadow_attack(void);
+
+/* what the attack code calls instead, see attack.h */
+void shadow_spi_begin(void);
+uint8_t shadow_spi_io(uint8_t v);
+void shadow_spi_end(uint16_t line);
+void shadow_reg_write(uint8_t reg, uint8_t value);
+void shadow_change_state(uint8_t new);
+void shadow_slp_tr(void);
+
+#endif /* !SHADOW_H */
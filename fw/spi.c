@@ -18,21 +18,20 @@
 
 #include "board.h"
 #include "spi.h"
+#include "hal.h"
 
 
 uint8_t spi_io(uint8_t v)
 {
 //      while (!(UCSR1A & 1 << UDRE1));
-	SPI_DATA = v;
-	SPI_WAIT_DONE();
-	return SPI_DATA;
+	return hal_spi_io(v);
 }
 
 
 void spi_end(void)
 {
 //      while (!(UCSR1A & 1 << TXC1));
-	SET(nSS);
+	hal_spi_end();
 }
 
 
@@ -13,9 +13,13 @@
 #ifndef SPI_H
 #define	SPI_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
+extern bool spi_initialized;
+
+
 void spi_begin(void);
 uint8_t spi_io(uint8_t v);
 void spi_end(void);
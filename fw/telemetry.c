@@ -0,0 +1,114 @@
+/*
+ * fw/telemetry.c - Diagnostic record stream on its own IN endpoint
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Records are queued in a byte ring and EP2 drains it as a plain byte
+ * stream, so several records can share one transfer and a record may be
+ * split across two. Captured frames on EP1 never wait for any of this.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <util/atomic.h>
+
+#include "usb.h"
+
+#include "board.h"
+#include "atusb/atusb.h"
+#include "telemetry.h"
+
+
+#define	TELEM_BUF	BOARD_TELEM_BUF		/* power of two */
+#define	TELEM_MASK	(TELEM_BUF-1)
+
+
+static uint8_t telem_buf[TELEM_BUF];
+static uint16_t head = 0, tail = 0;	/* we add at head, EP2 sends from tail */
+static uint8_t in_flight = 0;
+static uint16_t dropped = 0;
+
+
+static void kick(void);
+
+
+static void sent(void *user)
+{
+	tail = (tail+in_flight) & TELEM_MASK;
+	in_flight = 0;
+	kick();
+}
+
+
+static void kick(void)
+{
+	uint16_t n;
+
+	if (head == tail)
+		return;
+	n = head > tail ? head-tail : TELEM_BUF-tail;
+	if (n > 255)
+		n = 255;
+	in_flight = n;
+	usb_send(&eps[2], telem_buf+tail, n, sent, NULL);
+}
+
+
+static bool enqueue(uint8_t type, const uint8_t *data, uint8_t len)
+{
+	if (((tail-head-1) & TELEM_MASK) < len+2)
+		return 0;
+	telem_buf[head] = type;
+	head = (head+1) & TELEM_MASK;
+	telem_buf[head] = len;
+	head = (head+1) & TELEM_MASK;
+	while (len--) {
+		telem_buf[head] = *data++;
+		head = (head+1) & TELEM_MASK;
+	}
+	return 1;
+}
+
+
+/*
+ * Queue a record. This may be called from any context. If the queue is full,
+ * the record is dropped and counted, and the count goes out ahead of the next
+ * record that fits.
+ */
+
+bool telemetry_send(uint8_t type, const void *data, uint8_t len)
+{
+	bool ok = 0;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (dropped && enqueue(ATUSB_TELEM_DROPPED,
+		    (const uint8_t *) &dropped, sizeof(dropped)))
+			dropped = 0;
+		ok = enqueue(type, data, len);
+		if (!ok && dropped != 0xffff)
+			dropped++;
+		if (eps[2].state == EP_IDLE)
+			kick();
+	}
+	return ok;
+}
+
+
+void telemetry_reset(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		head = tail = 0;
+		in_flight = 0;
+		dropped = 0;
+	}
+}
@@ -0,0 +1,23 @@
+/*
+ * fw/telemetry.h - Diagnostic record stream on its own IN endpoint
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef TELEMETRY_H
+#define	TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+bool telemetry_send(uint8_t type, const void *data, uint8_t len);
+void telemetry_reset(void);
+
+#endif /* !TELEMETRY_H */
@@ -0,0 +1,165 @@
+/*
+ * fw/template.c - Frames preloaded by the host for ATUSB_TX_TEMPLATE
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The templates are packed into one pool, in no particular order. Replacing
+ * or deleting one moves the ones behind it down, so there are no holes.
+ *
+ * The frame buffer is shared with reception, so we remember which template
+ * it holds only until something else may have written to it. mac.c tells us
+ * about every interrupt other than the end of our own transmission, about
+ * frames it sends itself, and when reception is turned on or off, and ep0.c
+ * about raw buffer and SPI writes. As long as the frame buffer still has the
+ * template, we only write the patched bytes with SRAM_WRITE, which is why
+ * patches also go into the stored template.
+ *
+ * Every frame that comes in overwrites the frame buffer, also one the
+ * address filter then rejects, or one that FORCE_PLL_ON cuts off. We only
+ * hear of it if IRQ_MASK lets RX_START through, so we trust the frame buffer
+ * only then.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "at86rf230.h"
+#include "spi.h"
+#include "board.h"
+#include "atusb/atusb.h"
+#include "template.h"
+
+
+#define	SLOTS	ATUSB_TEMPLATE_SLOTS
+#define	NONE	0xff
+
+
+static uint8_t pool[BOARD_TEMPLATE_BUF];
+static uint16_t start[SLOTS];
+static uint8_t size[SLOTS];		/* 0 if the slot is empty */
+static uint16_t used = 0;
+static uint8_t loaded = NONE;		/* template in the frame buffer */
+
+
+/* ----- Storage ----------------------------------------------------------- */
+
+
+static void delete(uint8_t slot)
+{
+	uint16_t from = start[slot];
+	uint8_t len = size[slot];
+	uint8_t i;
+
+	if (!len)
+		return;
+	memmove(pool+from, pool+from+len, used-from-len);
+	used -= len;
+	for (i = 0; i != SLOTS; i++)
+		if (size[i] && start[i] > from)
+			start[i] -= len;
+	size[slot] = 0;
+}
+
+
+bool template_fits(uint8_t slot, uint8_t len)
+{
+	if (slot >= SLOTS || len > MAX_PSDU-2)
+		return 0;
+	return used-size[slot]+len <= BOARD_TEMPLATE_BUF;
+}
+
+
+void template_set(uint8_t slot, const uint8_t *buf, uint8_t len)
+{
+	if (!template_fits(slot, len))
+		return;
+	if (loaded == slot)
+		loaded = NONE;
+	delete(slot);
+	memcpy(pool+used, buf, len);
+	start[slot] = used;
+	size[slot] = len;
+	used += len;
+}
+
+
+bool template_valid(uint8_t slot)
+{
+	return slot < SLOTS && size[slot];
+}
+
+
+/* ----- Transmission ------------------------------------------------------ */
+
+
+static bool patch_ok(uint8_t slot, const uint8_t *patch, uint8_t len)
+{
+	const uint8_t *end = patch+len;
+
+	while (patch != end) {
+		if (end-patch < 2 || end-patch-2 < patch[1])
+			return 0;
+		if (patch[0]+patch[1] > size[slot])
+			return 0;
+		patch += 2+patch[1];
+	}
+	return 1;
+}
+
+
+static void write_all(uint8_t slot)
+{
+	const uint8_t *p = pool+start[slot];
+	uint8_t i;
+
+	spi_begin();
+	spi_send(AT86RF230_BUF_WRITE);
+	spi_send(size[slot]+2);		/* CRC */
+	for (i = 0; i != size[slot]; i++)
+		spi_send(p[i]);
+	spi_end();
+}
+
+
+bool template_load(uint8_t slot, const uint8_t *patch, uint8_t len)
+{
+	const uint8_t *end = patch+len;
+	uint8_t *p = pool+start[slot];
+	bool cached;
+	uint8_t i;
+
+	if (!template_valid(slot) || !patch_ok(slot, patch, len))
+		return 0;
+	cached = loaded == slot && (reg_read(REG_IRQ_MASK) & IRQ_RX_START);
+	while (patch != end) {
+		memcpy(p+patch[0], patch+2, patch[1]);
+		if (cached && patch[1]) {
+			spi_begin();
+			spi_send(AT86RF230_SRAM_WRITE);
+			spi_send(1+patch[0]);	/* after the PHR */
+			for (i = 0; i != patch[1]; i++)
+				spi_send(patch[2+i]);
+			spi_end();
+		}
+		patch += 2+patch[1];
+	}
+	if (!cached)
+		write_all(slot);
+	loaded = slot;
+	return 1;
+}
+
+
+void template_forget(void)
+{
+	loaded = NONE;
+}
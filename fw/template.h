@@ -0,0 +1,34 @@
+/*
+ * fw/template.h - Frames preloaded by the host for ATUSB_TX_TEMPLATE
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef TEMPLATE_H
+#define	TEMPLATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* whether a template of len bytes fits in the slot, replacing what's there */
+bool template_fits(uint8_t slot, uint8_t len);
+
+/* store, or delete if len is 0 */
+void template_set(uint8_t slot, const uint8_t *buf, uint8_t len);
+
+bool template_valid(uint8_t slot);
+
+/* patch the template and put it into the frame buffer, in PLL_ON */
+bool template_load(uint8_t slot, const uint8_t *patch, uint8_t len);
+
+/* someone else has changed the frame buffer */
+void template_forget(void);
+
+#endif /* !TEMPLATE_H */
@@ -0,0 +1,145 @@
+/*
+ * fw/timer.c - One-shot and periodic callbacks on timer 1
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Pending timers are kept in a list sorted by due time, and compare C of
+ * timer 1 is set for the first one. Due times are the low 32 bits of the
+ * 48 bit time of timer_read (about nine minutes) and are compared as signed
+ * differences, so they wrap correctly. Timers further away than the 16 bit
+ * counter reaches take intermediate compares.
+ *
+ * A periodic timer's next due time is its previous one plus the period, so
+ * a late callback doesn't shift the ones that follow.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "board.h"
+#include "timer.h"
+
+
+#define	MAX_WAIT	0x8000	/* ticks, for a single compare */
+#define	MIN_WAIT	32	/* ticks, so that the compare isn't already past */
+
+
+static struct timer *timers = NULL;
+
+
+static void enqueue(struct timer *t)
+{
+	struct timer **anchor;
+
+	for (anchor = &timers; *anchor; anchor = &(*anchor)->next)
+		if ((int32_t) (t->due-(*anchor)->due) < 0)
+			break;
+	t->next = *anchor;
+	*anchor = t;
+	t->queued = 1;
+}
+
+
+static void dequeue(struct timer *t)
+{
+	struct timer **anchor;
+
+	for (anchor = &timers; *anchor; anchor = &(*anchor)->next)
+		if (*anchor == t) {
+			*anchor = t->next;
+			break;
+		}
+	t->queued = 0;
+}
+
+
+static void arm(void)
+{
+	int32_t wait;
+
+	if (!timers) {
+		TIMSK1 &= ~(1 << OCIE1C);
+		return;
+	}
+
+	/* read the time here, not before walking the list */
+	wait = timers->due-(uint32_t) timer_read();
+	if (wait > MAX_WAIT)
+		OCR1C = TCNT1+MAX_WAIT;
+	else if (wait < MIN_WAIT)
+		OCR1C = TCNT1+MIN_WAIT;
+	else
+		OCR1C = timers->due;
+	TIFR1 = 1 << OCF1C;
+	TIMSK1 |= 1 << OCIE1C;
+
+	/*
+	 * If an interrupt delayed us, the counter may have passed the compare
+	 * already, and the flag we just cleared may have been its match. We'd
+	 * then only get the call when the counter comes around again.
+	 */
+	if ((int16_t) (TCNT1-OCR1C) >= 0)
+		OCR1C = TCNT1+MIN_WAIT;
+}
+
+
+ISR(TIMER1_COMPC_vect)
+{
+	struct timer *t;
+
+	while (timers && (int32_t) (timers->due-(uint32_t) timer_read()) <= 0) {
+		t = timers;
+		timers = t->next;
+		t->queued = 0;
+		if (t->period) {
+			t->due += t->period;
+			enqueue(t);
+		}
+		t->fn(t->user);
+	}
+	arm();
+}
+
+
+void timer_start(struct timer *t, uint32_t delay, uint32_t period,
+    void (*fn)(void *user), void *user)
+{
+	uint32_t now;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		now = timer_read();
+		if (t->queued)
+			dequeue(t);
+		t->due = now+delay;
+		t->period = period;
+		t->fn = fn;
+		t->user = user;
+		enqueue(t);
+		if (timers == t)
+			arm();
+	}
+}
+
+
+void timer_cancel(struct timer *t)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (t->queued) {
+			dequeue(t);
+			arm();
+		}
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * fw/timer.h - One-shot and periodic callbacks on timer 1
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef TIMER_H
+#define	TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define	TIMER_US(us)	((uint32_t) (us)*8)	/* timer 1 runs at 8 MHz */
+#define	TIMER_MS(ms)	TIMER_US((uint32_t) (ms)*1000)
+
+
+/*
+ * The caller owns the struct timer. Callbacks run in interrupt context and
+ * may start or cancel any timer, including their own.
+ */
+
+struct timer {
+	struct timer *next;
+	uint32_t due;			/* timer 1 ticks, low 32 bits */
+	uint32_t period;		/* 0 for a one-shot timer */
+	bool queued;
+	void (*fn)(void *user);
+	void *user;
+};
+
+
+/* (re)start, with the first call after "delay" ticks, then every "period" */
+void timer_start(struct timer *t, uint32_t delay, uint32_t period,
+    void (*fn)(void *user), void *user);
+void timer_cancel(struct timer *t);
+
+#endif /* !TIMER_H */
@@ -34,6 +34,14 @@
 #define NULL 0
 #endif
 
+/* UECFG1X.EPSIZE for a bulk endpoint of 8 to 64 bytes */
+#define	EPSIZE(size) \
+	((size) == 8 ? 0 : (size) == 16 ? 1 : (size) == 32 ? 2 : 3)
+
+#if EP2_SIZE != 8 && EP2_SIZE != 16 && EP2_SIZE != 32 && EP2_SIZE != 64
+#error "EP2_SIZE must be 8, 16, 32, or 64 bytes"
+#endif
+
 #if 1
 #define BUG_ON(cond)    do { if (cond) panic(); } while (0)
 #else
@@ -69,9 +77,17 @@ void set_addr(uint8_t addr)
 
 void usb_ep_change(struct ep_descr *ep)
 {
+	uint8_t num;
+
+	/*
+	 * We may be called from a callback in the middle of handle_ep() for
+	 * another endpoint, so leave UENUM the way we found it.
+	 */
 	if (ep->state == EP_TX) {
+		num = UENUM;
 		UENUM = ep-eps;
 		UEIENX |= 1 << TXINE;
+		UENUM = num;
 	}
 }
 
@@ -118,11 +134,10 @@ static bool ep_rx(struct ep_descr *ep)
 
 static void ep_tx(struct ep_descr *ep)
 {
-	uint8_t size = ep->end-ep->buf;
-	uint8_t left;
+	uint16_t remain = ep->end-ep->buf;
+	uint8_t size, left;
 
-	if (size > ep->size)
-		size = ep->size;
+	size = remain > ep->size ? ep->size : remain;
 	for (left = size; left; left--)
 		UEDATX = *ep->buf++;
 	if (size == ep->size)
@@ -157,19 +172,28 @@ static void handle_ep(int n)
 		ep->state = EP_IDLE;
 		UEINTX = ~(1 << STALLEDI);
 	}
-	if (UEINTX & (1 << TXINI)) {
+	/*
+	 * On a double-banked IN endpoint, TXINI comes back as soon as we have
+	 * handed one bank to the controller, so we keep filling the free bank
+	 * while the other one is on the wire. If the callback queues the next
+	 * transfer, that one goes out back-to-back as well. EP0 has a single
+	 * bank and keeps to one packet per interrupt.
+	 */
+	while (UEINTX & (1 << TXINI)) {
 		/* @@ EP_RX: cancel (?) */
-		if (ep->state == EP_TX) {
-			ep_tx(ep);
-			mask = 1 << TXINI;
-			if (n)
-				mask |= 1 << FIFOCON;
-			UEINTX = ~mask;
-			if (ep->state == EP_IDLE && ep->callback)
-				ep->callback(ep->user);
-		} else {
+		if (ep->state != EP_TX) {
 			UEIENX &= ~(1 << TXINE);
+			break;
 		}
+		ep_tx(ep);
+		mask = 1 << TXINI;
+		if (n)
+			mask |= 1 << FIFOCON;
+		UEINTX = ~mask;
+		if (ep->state == EP_IDLE && ep->callback)
+			ep->callback(ep->user);
+		if (!n)
+			break;
 	}
 	return;
 
@@ -202,6 +226,7 @@ void ep_init(void)
 	UECONX = (1 << RSTDT) | (1 << EPEN);	/* enable */
 	UECFG0X = (1 << EPTYPE1) | (1 << EPDIR); /* bulk IN */
 	UECFG1X = 3 << EPSIZE0;	/* 64 bytes */
+	UECFG1X |= (BOARD_EP1_BANKS-1) << EPBK0;	/* see handle_ep */
 	UECFG1X |= 1 << ALLOC;
 
 	while (!(UESTA0X & (1 << CFGOK)));
@@ -211,6 +236,20 @@ void ep_init(void)
 	eps[1].state = EP_IDLE;
 	eps[1].size = 64;
 
+	UENUM = 2;
+	UECONX = (1 << RSTDT) | (1 << EPEN);	/* enable */
+	UECFG0X = (1 << EPTYPE1) | (1 << EPDIR); /* bulk IN */
+	UECFG1X = EPSIZE(EP2_SIZE) << EPSIZE0;
+	UECFG1X |= (BOARD_EP2_BANKS-1) << EPBK0;
+	UECFG1X |= 1 << ALLOC;
+
+	while (!(UESTA0X & (1 << CFGOK)));
+
+	UEIENX = (1 << STALLEDE) | (1 << TXINE);
+
+	eps[2].state = EP_IDLE;
+	eps[2].size = EP2_SIZE;
+
 #endif
 }
 
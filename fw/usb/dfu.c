@@ -18,10 +18,13 @@
  * A few, erm, shortcuts:
  *
  * - we don't bother with the app* states since DFU is all this firmware does
- * - after DFU_DNLOAD, we just block until things are written, so we never
- *   enter dfuDNLOAD_SYNC or dfuDNBUSY
- * - no dfuMANIFEST_SYNC, dfuMANIFEST, or dfuMANIFEST_WAIT_RESET
- * - to keep our buffers small, we only accept EP0-sized blocks
+ * - no dfuMANIFEST_WAIT_RESET, we're manifestation tolerant
+ * - blocks are at most DFU_TRANSFER_SIZE bytes
+ *
+ * DFU_DNLOAD only hands the block to the flash driver, which programs it in
+ * the background. DFU_GETSTATUS then reports dfuDNBUSY or dfuMANIFEST, with
+ * the driver's estimate of how long this will take as bwPollTimeout, until
+ * the driver can take the next block or has written everything.
  */
 
 
@@ -104,11 +107,14 @@ const uint8_t config_descriptor[] = {
 };
 
 
+bool dfu_delta = 0;
+
 static uint16_t next_block = 0;
 static bool did_download;
+static bool delta;		/* this download seeks to its block numbers */
 
 
-static uint8_t buf[EP0_SIZE];
+static uint8_t buf[DFU_TRANSFER_SIZE];
 
 
 static void block_write(void *user)
@@ -128,7 +134,7 @@ static bool block_receive(uint16_t length)
 		dfu.status = errADDRESS;
 		return 0;
 	}
-	if (length > EP0_SIZE) {
+	if (length > DFU_TRANSFER_SIZE) {
 		dfu.state = dfuERROR;	
 		dfu.status = errUNKNOWN;
 		return 0;
@@ -143,7 +149,7 @@ static bool block_transmit(uint16_t length)
 {
 	uint16_t got;
 
-	if (length > EP0_SIZE) {
+	if (length > DFU_TRANSFER_SIZE) {
 		dfu.state = dfuERROR;	
 		dfu.status = errUNKNOWN;
 		return 1;
@@ -158,6 +164,45 @@ static bool block_transmit(uint16_t length)
 }
 
 
+/*
+ * In a delta download, block n goes to n*DFU_TRANSFER_SIZE, and the host may
+ * skip blocks it knows to be unchanged.
+ */
+
+static bool seek_block(uint16_t block)
+{
+	if (!dfu_flash_ops->seek ||
+	    !dfu_flash_ops->seek((uint32_t) block*DFU_TRANSFER_SIZE))
+		return 0;
+	next_block = block;
+	return 1;
+}
+
+
+static void update_status(void)
+{
+	uint16_t ms;
+
+	switch (dfu.state) {
+	case dfuDNLOAD_SYNC:
+	case dfuDNBUSY:
+		ms = dfu_flash_ops->busy(0);
+		dfu.state = ms ? dfuDNBUSY : dfuDNLOAD_IDLE;
+		break;
+	case dfuMANIFEST_SYNC:
+	case dfuMANIFEST:
+		ms = dfu_flash_ops->busy(1);
+		dfu.state = ms ? dfuMANIFEST : dfuIDLE;
+		break;
+	default:
+		return;
+	}
+	dfu.toL = ms;
+	dfu.toM = ms >> 8;
+	dfu.toH = 0;
+}
+
+
 static bool my_setup(const struct setup_request *setup)
 {
 	bool ok;
@@ -174,7 +219,9 @@ static bool my_setup(const struct setup_request *setup)
 	case DFU_TO_DEV(DFU_DNLOAD):
 		debug("DFU_DNLOAD\n");
 		if (dfu.state == dfuIDLE) {
-			next_block = setup->wValue;
+			delta = dfu_delta;
+			dfu_delta = 0;
+			next_block = delta ? 0 : setup->wValue;
 			dfu_flash_ops->start();
 		}
 		else if (dfu.state != dfuDNLOAD_IDLE) {
@@ -185,7 +232,8 @@ static bool my_setup(const struct setup_request *setup)
 			debug("retransmisson\n");
 			return 1;
 		}
-		if (setup->wValue != next_block) {
+		if (setup->wValue != next_block &&
+		    !(delta && seek_block(setup->wValue))) {
 			debug("bad block (%d vs. %d)\n",
 			    setup->wValue, next_block);
 			dfu.state = dfuERROR;
@@ -195,13 +243,14 @@ static bool my_setup(const struct setup_request *setup)
 		if (!setup->wLength) {
 			debug("DONE\n");
 			dfu_flash_ops->end_write();
-			dfu.state = dfuIDLE;
+			dfu.state = dfuMANIFEST_SYNC;
 			did_download = 1;
 			return 1;
 		}
 		ok = block_receive(setup->wLength);
 		next_block++;
-		dfu.state = dfuDNLOAD_IDLE;
+		if (ok)
+			dfu.state = dfuDNLOAD_SYNC;
 		return ok;
 	case DFU_FROM_DEV(DFU_UPLOAD):
 		debug("DFU_UPLOAD\n");
@@ -229,8 +278,15 @@ static bool my_setup(const struct setup_request *setup)
 		next_block++;
 		dfu.state = dfuUPLOAD_IDLE;
 		return ok;
+	case DFU_FROM_DEV(DFU_GETSTATUS):
+		update_status();
+		return dfu_setup_common(setup);
 	case DFU_TO_DEV(DFU_ABORT):
 		debug("DFU_ABORT\n");
+		/* let the driver finish the pages it already has */
+		if (dfu.state == dfuDNLOAD_SYNC || dfu.state == dfuDNBUSY ||
+		    dfu.state == dfuDNLOAD_IDLE)
+			dfu_flash_ops->end_write();
 		dfu.state = dfuIDLE;
 		dfu.status = OK;
 		return 1;
@@ -98,11 +98,24 @@ struct dfu {
 	(idx),			/* iInterface */
 
 
+/*
+ * write() and end_write() only queue data and may be called from interrupt
+ * context. The actual programming is done by poll(), which the boot loader's
+ * main loop calls continuously. busy(0) estimates how many milliseconds it
+ * will take until a block of DFU_TRANSFER_SIZE bytes can be accepted, busy(1)
+ * until everything queued has been written. Both return 0 if there's no need
+ * to wait. seek() moves the write position to where a DFU_DNLOAD block that
+ * doesn't follow the previous one goes; it may be NULL.
+ */
+
 struct dfu_flash_ops {
 	void (*start)(void);
+	bool (*seek)(uint32_t pos);
 	bool (*can_write)(uint16_t size);
 	void (*write)(const uint8_t *buf, uint16_t size);
 	void (*end_write)(void);
+	uint16_t (*busy)(bool all);
+	void (*poll)(void);
 	uint16_t (*read)(uint8_t *buf, uint16_t size);
 };
 
@@ -110,6 +123,14 @@ extern struct dfu dfu;
 extern const struct dfu_flash_ops *dfu_flash_ops;
 
 
+/*
+ * Set by the boot loader when the host announces a delta download. The next
+ * DFU_DNLOAD in dfuIDLE takes it, and its blocks then go to their block
+ * number, as far as seek() allows.
+ */
+extern bool dfu_delta;
+
+
 bool dfu_setup_common(const struct setup_request *setup);
 bool dfu_my_descr(uint8_t type, uint8_t index, const uint8_t **reply,
     uint8_t *size);
@@ -18,10 +18,7 @@
  * A few, erm, shortcuts:
  *
  * - we don't bother with the app* states since DFU is all this firmware does
- * - after DFU_DNLOAD, we just block until things are written, so we never
- *   enter dfuDNLOAD_SYNC or dfuDNBUSY
- * - no dfuMANIFEST_SYNC, dfuMANIFEST, or dfuMANIFEST_WAIT_RESET
- * - to keep our buffers small, we only accept EP0-sized blocks
+ * - no dfuMANIFEST_WAIT_RESET, we're manifestation tolerant
  */
 
 
@@ -48,14 +45,15 @@ static const uint8_t functional_descriptor[] = {
 	DFU_DT_FUNCTIONAL,	/* bDescriptorType */
 	0xf,			/* bmAttributes (claim omnipotence :-) */
 	LE(0xffff),		/* wDetachTimeOut (we're very patient) */
-	LE(EP0_SIZE),		/* wTransferSize */
+	LE(DFU_TRANSFER_SIZE),	/* wTransferSize */
 	LE(0x101),		/* bcdDFUVersion */
 };
 
 
 /*
- * The worst-case activity would be flashing a one page and erasing another
- * one, would should take less than 10 ms. A 100 ms timeout ought to be plenty.
+ * The boot loader replaces bwPollTimeout with an estimate while it is
+ * programming, see update_status() in dfu.c. Elsewhere, nothing is pending
+ * and the value doesn't matter.
  */
 
 struct dfu dfu = {
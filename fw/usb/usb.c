@@ -42,7 +42,7 @@ void (*user_reset)(void);
 
 
 void usb_io(struct ep_descr *ep, enum ep_state state, uint8_t *buf,
-    uint8_t size, void (*callback)(void *user), void *user)
+    uint16_t size, void (*callback)(void *user), void *user)
 {
 	BUG_ON(ep->state);
 	ep->state = state;
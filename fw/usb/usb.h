@@ -131,6 +131,7 @@
 #endif
 
 #define	EP1_SIZE	64	/* simplify */
+#define	EP2_SIZE	32	/* fits next to EP0 and EP1 in 176 bytes */
 
 
 enum ep_state {
@@ -176,7 +177,7 @@ extern void (*user_reset)(void);
 	usb_io(ep, EP_RX, buf, size, callback, user)
 
 void usb_io(struct ep_descr *ep, enum ep_state state, uint8_t *buf,
-    uint8_t size, void (*callback)(void *user), void *user);
+    uint16_t size, void (*callback)(void *user), void *user);
 
 bool handle_setup(const struct setup_request *setup);
 void set_addr(uint8_t addr);
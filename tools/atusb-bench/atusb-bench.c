@@ -0,0 +1,163 @@
+/*
+ * atusb-bench/atusb-bench.c - Time SPI and transceiver access on the device
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The device needs firmware built with "make bench". It does all the timing
+ * itself, so USB latency doesn't enter the results.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libusb.h>
+
+#include "at86rf230.h"
+#include "atusb/atusb.h"
+
+#include "atusb-dev.h"
+
+
+#define	BYTES		16	/* default for primitives that take bytes */
+#define	MHZ		8	/* CPU clock */
+
+
+static const struct primitive {
+	const char *name;
+	bool bytes;	/* takes a byte count */
+	bool tx;	/* transmits, only run if asked for */
+} primitives[ATUSB_BENCH_PRIMITIVES] = {
+	[ATUSB_BENCH_NONE]	= { "none",		0, 0 },
+	[ATUSB_BENCH_SPI_IO]	= { "spi_io",		0, 0 },
+	[ATUSB_BENCH_SPI_BLOCK]	= { "spi_block",	1, 0 },
+	[ATUSB_BENCH_REG_READ]	= { "reg_read",		0, 0 },
+	[ATUSB_BENCH_STATE]	= { "state",		0, 0 },
+	[ATUSB_BENCH_BUF_WRITE]	= { "buf_write",	1, 0 },
+	[ATUSB_BENCH_BUF_READ]	= { "buf_read",		1, 0 },
+	[ATUSB_BENCH_SRAM_READ]	= { "sram_read",	0, 0 },
+	[ATUSB_BENCH_SLP_TR]	= { "slp_tr",		1, 1 },
+};
+
+
+static int lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i != ATUSB_BENCH_PRIMITIVES; i++)
+		if (!strcmp(primitives[i].name, name))
+			return i;
+	return -1;
+}
+
+
+static int run(struct atusb_dev *dev, int id, uint8_t bytes)
+{
+	const struct primitive *p = primitives+id;
+	struct atusb_bench_result res;
+
+	if (!p->bytes)
+		bytes = 0;
+	if (atusb_bench(dev, id, bytes, &res))
+		return -1;
+	printf("%-10s %5u %6u %6u %6u %8.2f %8.2f %6u\n", p->name, bytes,
+	    res.min, res.mean, res.max, (double) res.mean/MHZ,
+	    (double) res.max/MHZ, res.errors);
+	return 0;
+}
+
+
+static void usage(const char *name)
+{
+	int i;
+
+	fprintf(stderr,
+"usage: %s [-d vendor:product] [-i index] [-n bytes] [primitive ...]\n\n"
+"  -d vendor:product  USB ID of the device (default: %04x:%04x)\n"
+"  -i index           use the index-th matching device (default: 0)\n"
+"  -n bytes           for primitives that take them, 1-%d (default: %d)\n"
+"  primitive          what to time (default: all but slp_tr, which sends)\n\n"
+"Prints the primitive, the bytes, the fewest, mean, and most CPU cycles of\n"
+"%d runs, the mean and most in microseconds, and the number of runs that\n"
+"read back wrong data or didn't reach the expected transceiver state.\n\n"
+"Primitives:"
+    , name, ATUSB_VENDOR_ID, ATUSB_PRODUCT_ID, MAX_PSDU, BYTES,
+    ATUSB_BENCH_RUNS);
+	for (i = 0; i != ATUSB_BENCH_PRIMITIVES; i++)
+		fprintf(stderr, " %s", primitives[i].name);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	uint16_t vendor = ATUSB_VENDOR_ID, product = ATUSB_PRODUCT_ID;
+	libusb_context *ctx;
+	struct atusb_dev *dev;
+	unsigned long bytes = BYTES;
+	char *end;
+	int nth = 0, opt, id, res = 1;
+	int i;
+
+	while ((opt = getopt(argc, argv, "d:i:n:")) != EOF)
+		switch (opt) {
+		case 'd':
+			if (sscanf(optarg, "%hx:%hx", &vendor, &product) != 2)
+				usage(*argv);
+			break;
+		case 'i':
+			nth = strtoul(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 'n':
+			bytes = strtoul(optarg, &end, 0);
+			if (*end || !bytes || bytes > MAX_PSDU)
+				usage(*argv);
+			break;
+		default:
+			usage(*argv);
+		}
+	for (i = optind; i != argc; i++)
+		if (lookup(argv[i]) < 0)
+			usage(*argv);
+
+	if (libusb_init(&ctx)) {
+		fprintf(stderr, "libusb_init failed\n");
+		return 1;
+	}
+	dev = atusb_open(ctx, vendor, product, nth);
+	if (!dev)
+		goto out_exit;
+
+	printf("#primitive bytes    min   mean    max  mean/us   max/us errors\n");
+	if (optind == argc) {
+		for (id = 0; id != ATUSB_BENCH_PRIMITIVES; id++)
+			if (!primitives[id].tx && run(dev, id, bytes))
+				goto out_close;
+	} else {
+		for (i = optind; i != argc; i++)
+			if (run(dev, lookup(argv[i]), bytes))
+				goto out_close;
+	}
+	res = 0;
+
+out_close:
+	atusb_close(dev);
+out_exit:
+	libusb_exit(ctx);
+	return res;
+}
@@ -0,0 +1,505 @@
+/*
+ * atusb-cap/atusb-cap.c - Capture frames from an ATUSB into a pcapng file
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * We talk to the device directly through libusb, bypassing the kernel
+ * driver, and ask it for the record trailer with ED level, CRC status,
+ * channel, and device time. The raw record stream can be saved and later
+ * replayed through the same decoding path, so that everything past USB can
+ * be tested without hardware.
+ *
+ * Device time is mapped to host time by clksync, which we feed once per
+ * CLKSYNC_INTERVAL_MS. The samples also go into the raw dump, so that a
+ * replay converts timestamps exactly as the live capture did.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <libusb.h>
+
+#include "atusb/atusb.h"
+
+#include "atusb-dev.h"
+#include "cap.h"
+#include "rec.h"
+#include "clksync.h"
+#include "pcapng.h"
+#include "rawdump.h"
+#include "shmring.h"
+
+
+struct capture {
+	struct pcapng *pcapng;
+	int itf;
+	FILE *raw;
+	FILE *events;		/* SHADOW decisions */
+	struct shmring *ring;
+	uint8_t hw_type;
+	int channel;
+	struct clksync *cs;
+	const uint8_t *filter;
+	const uint8_t *hop;
+	int hop_len;
+	bool synced;		/* replay: seen a clock sync record */
+	uint64_t frames, bad, limit;
+};
+
+
+static volatile sig_atomic_t stop = 0;
+static bool quiet = 0;
+
+
+static void handle_signal(int sig)
+{
+	stop = 1;
+}
+
+
+/* ----- Record processing ------------------------------------------------- */
+
+
+static void publish(struct shmring *ring, int itf, uint64_t ns,
+    const struct atusb_frame *f, const struct pcapng_tap *tap)
+{
+	struct shmring_frame sf;
+
+	sf.ns = ns;
+	sf.itf = itf;
+	sf.len = f->len;
+	sf.lqi = f->lqi;
+	sf.ed = f->ed;
+	sf.channel = tap->channel;
+	sf.flags = 0;
+	if (f->has_trailer)
+		sf.flags |= SHMRING_F_TRAILER;
+	if (tap->crc_known)
+		sf.flags |= SHMRING_F_CRC_KNOWN;
+	if (tap->crc_ok)
+		sf.flags |= SHMRING_F_CRC_OK;
+	sf.reserved = 0;
+	sf.rss = tap->rss;
+	memcpy(sf.psdu, f->psdu, f->len);
+	shmring_put(ring, &sf);
+}
+
+
+static void record(void *user, const uint8_t *buf, int len, uint64_t ns)
+{
+	struct capture *c = user;
+	struct atusb_frame f;
+	struct pcapng_tap tap;
+
+	if (c->raw && rawdump_write(c->raw, buf, len, ns))
+		stop = 1;
+
+	switch (atusb_rec_decode(buf, len, &f)) {
+	case atusb_rec_frame:
+		break;
+	case atusb_rec_bad:
+		c->bad++;
+		return;
+	default:
+		return;
+	}
+
+	memset(&tap, 0, sizeof(tap));
+	tap.has_lqi = 1;
+	tap.lqi = f.lqi;
+	tap.channel = c->channel;
+	if (f.has_trailer) {
+		ns = clksync_wall(c->cs, f.ticks);
+		tap.has_rss = 1;
+		tap.rss = atusb_hw_ed_to_dbm(c->hw_type, f.ed);
+		tap.channel = f.flags & ATUSB_RX_FLAG_CHAN_MASK;
+		tap.crc_known = atusb_frame_crc_known(&f);
+		tap.crc_ok = atusb_frame_crc_ok(&f);
+	}
+	if (c->ring)
+		publish(c->ring, c->itf, ns, &f, &tap);
+	if (c->pcapng &&
+	    pcapng_packet(c->pcapng, c->itf, ns, f.psdu, f.len, &tap))
+		stop = 1;
+	if (++c->frames == c->limit)
+		stop = 1;
+}
+
+
+/* ----- Sources ----------------------------------------------------------- */
+
+
+static int sync_time(struct atusb_dev *dev, struct capture *c)
+{
+	struct clksync_sample s;
+
+	if (clksync_measure(c->cs, dev, CLKSYNC_ROUNDS, &s))
+		return -1;
+	if (c->raw && rawdump_write_sync(c->raw, &s, atusb_host_ns()))
+		return -1;
+	return 0;
+}
+
+
+static void shadow_event(void *user, uint8_t type, const uint8_t *buf,
+    uint8_t len)
+{
+	static const char *decision[] = { "pass", "tx", "state", "tx+state" };
+	struct capture *c = user;
+	uint64_t ticks = 0, ns;
+	int i;
+
+	if (type != ATUSB_TELEM_SHADOW || len < ATUSB_SHADOW_REC_SIZE)
+		return;
+	for (i = 5; i >= 0; i--)
+		ticks = ticks << 8 | buf[i];
+	ns = clksync_wall(c->cs, ticks);
+	fprintf(c->events, "%llu.%09llu %02u %u %u %s",
+	    (unsigned long long) ns/1000000000,
+	    (unsigned long long) ns % 1000000000, buf[6],
+	    buf[8] | buf[9] << 8, buf[10] | buf[11] << 8,
+	    decision[buf[7] & (ATUSB_SHADOW_TX | ATUSB_SHADOW_STATE)]);
+	for (i = ATUSB_SHADOW_REC_SIZE; i != len; i++)
+		fprintf(c->events, " %02x", buf[i]);
+	fputc('\n', c->events);
+}
+
+
+static void print_sync(const struct capture *c)
+{
+	if (!quiet && clksync_valid(c->cs))
+		fprintf(stderr, "device clock %+.2f ppm, fit residual %.1f us\n",
+		    clksync_ppm(c->cs), clksync_residual(c->cs)/1000);
+}
+
+
+static int capture_usb(struct capture *c, uint16_t vendor, uint16_t product,
+    int nth, int urbs)
+{
+	libusb_context *ctx;
+	struct atusb_dev *dev;
+	struct atusb_cap *cap;
+	const struct atusb_cap_stats *st;
+	struct atusb_rx_stats rx;
+	struct rawdump_hdr hdr;
+	struct timeval tv = { .tv_sec = 0, .tv_usec = 100*1000 };
+	struct clksync_sample s;
+	uint64_t next_sync;
+	int res = 1;
+
+	if (libusb_init(&ctx)) {
+		fprintf(stderr, "libusb_init failed\n");
+		return 1;
+	}
+	dev = atusb_open(ctx, vendor, product, nth);
+	if (!dev)
+		goto out_exit;
+	c->hw_type = dev->hw_type;
+	if (clksync_measure(c->cs, dev, CLKSYNC_ROUNDS, &s))
+		goto out_close;
+	if (c->raw) {
+		hdr.hw_type = c->hw_type;
+		hdr.ticks = s.ticks;
+		hdr.ns = clksync_wall(c->cs, s.ticks);
+		if (rawdump_write_hdr(c->raw, &hdr) ||
+		    rawdump_write_sync(c->raw, &s, atusb_host_ns()))
+			goto out_close;
+	}
+	next_sync = clksync_mono_ns()+CLKSYNC_INTERVAL_MS*1000000ULL;
+
+	cap = atusb_cap_start(ctx, dev, urbs, record, c);
+	if (!cap)
+		goto out_close;
+	if (c->events)
+		atusb_cap_telem(cap, shadow_event, c);
+	if (atusb_rx_start(dev, c->channel, ATUSB_RX_MODE_TRAILER, c->filter))
+		goto out_stop;
+	if (c->hop && atusb_hop(dev, c->hop, c->hop_len))
+		goto out_stop;
+	while (!stop) {
+		libusb_handle_events_timeout(ctx, &tv);
+		if (clksync_mono_ns() < next_sync)
+			continue;
+		if (sync_time(dev, c))
+			break;
+		next_sync += CLKSYNC_INTERVAL_MS*1000000ULL;
+	}
+	atusb_rx_stop(dev);
+	res = !stop;
+
+out_stop:
+	st = atusb_cap_stats(cap);
+	if (!quiet)
+		fprintf(stderr,
+		    "%llu records, %llu bytes, %llu USB errors, "
+		    "%u frames lost in device, %llu bad records\n",
+		    (unsigned long long) st->records,
+		    (unsigned long long) st->bytes,
+		    (unsigned long long) st->errors, st->rx_overruns,
+		    (unsigned long long) c->bad);
+	if (!quiet && c->filter && !atusb_rx_stats(dev, &rx))
+		fprintf(stderr, "%u of %u frames dropped by the filter\n",
+		    rx.filtered, rx.frames);
+	print_sync(c);
+	atusb_cap_stop(cap);
+out_close:
+	atusb_close(dev);
+out_exit:
+	libusb_exit(ctx);
+	return res;
+}
+
+
+static void replay_sync(void *user, const struct clksync_sample *s)
+{
+	struct capture *c = user;
+
+	if (!c->synced)
+		clksync_reset(c->cs);
+	c->synced = 1;
+	clksync_add(c->cs, s);
+}
+
+
+static int capture_replay(struct capture *c, const char *name)
+{
+	struct rawdump_hdr hdr;
+	struct clksync_sample s;
+	FILE *file;
+	int res;
+
+	file = fopen(name, "rb");
+	if (!file) {
+		perror(name);
+		return 1;
+	}
+	if (rawdump_read_hdr(file, &hdr)) {
+		fclose(file);
+		return 1;
+	}
+	c->hw_type = hdr.hw_type;
+
+	/*
+	 * Version 1 dumps only have the instant in the header. We use it until
+	 * the first clock sync record, if any, replaces it.
+	 */
+	s.ticks = hdr.ticks;
+	s.mono0 = s.mono1 = hdr.ns;
+	s.wall_off = 0;
+	clksync_add(c->cs, &s);
+
+	do res = rawdump_read(file, record, replay_sync, c);
+	while (res > 0 && !stop);
+	fclose(file);
+	if (!quiet)
+		fprintf(stderr, "%llu frames, %llu bad records\n",
+		    (unsigned long long) c->frames,
+		    (unsigned long long) c->bad);
+	print_sync(c);
+	return res < 0;
+}
+
+
+/* ----- Command line ------------------------------------------------------ */
+
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+"usage: %s [-c channel | -H schedule] [-d vendor:product] [-E events]\n"
+"       %*s [-F filter] [-i index] [-n count] [-q] [-R raw.out]\n"
+"       %*s [-s name [-S slots]] [-u urbs] [file.pcapng]\n"
+"       %s -r raw.in [-n count] [-q] [-s name [-S slots]] [file.pcapng]\n\n"
+"  -c channel         channel to capture on, 11 to 26 (default: 11)\n"
+"  -d vendor:product  USB ID of the device (default: %04x:%04x)\n"
+"  -E events          write the decisions of a SHADOW firmware's attack, one\n"
+"                     per line: time, attack, source line of the exit, CPU\n"
+"                     cycles, decision, and the header bytes it read\n"
+"  -F filter          drop other frames in the device, e.g.,\n"
+"                     type=data+cmd,pan=0x1a62,short=0x0000,bcast,crc\n"
+"  -H schedule        let the device hop channels, e.g., 11,15@250,20@0.5,\n"
+"                     staying there for the given milliseconds (default: %d)\n"
+"  -i index           use the index-th matching device (default: 0)\n"
+"  -n count           stop after that many frames\n"
+"  -q                 don't print statistics\n"
+"  -r raw.in          replay a raw dump instead of capturing\n"
+"  -R raw.out         also save the raw record stream\n"
+"  -s name            publish frames in shared memory object \"name\",\n"
+"                     e.g., /atusb, and only write a pcapng file if given\n"
+"  -S slots           size of that ring, a power of two (default: %d)\n"
+"  -u urbs            number of USB transfers in flight (default: %d)\n"
+"  file.pcapng        output file (default: standard output)\n"
+    , name, (int) strlen(name), "", (int) strlen(name), "", name,
+    ATUSB_VENDOR_ID, ATUSB_PRODUCT_ID,
+    ATUSB_HOP_DWELL_MS, SHMRING_SLOTS, ATUSB_CAP_URBS);
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	struct capture c;
+	uint16_t vendor = ATUSB_VENDOR_ID, product = ATUSB_PRODUCT_ID;
+	const char *replay = NULL, *raw = NULL, *shm = NULL;
+	const char *output = NULL, *events = NULL;
+	unsigned long slots = SHMRING_SLOTS;
+	uint8_t filter[ATUSB_RX_FILTER_SIZE];
+	uint8_t hop[ATUSB_HOP_SLOTS*ATUSB_HOP_ENTRY_SIZE];
+	char *end;
+	int nth = 0, urbs = ATUSB_CAP_URBS;
+	FILE *out = NULL;
+	int opt, res;
+
+	memset(&c, 0, sizeof(c));
+	c.channel = 11;
+
+	while ((opt = getopt(argc, argv, "c:d:E:F:H:i:n:qr:R:s:S:u:")) != EOF)
+		switch (opt) {
+		case 'c':
+			c.channel = strtoul(optarg, &end, 0);
+			if (*end || c.channel < 11 || c.channel > 26)
+				usage(*argv);
+			break;
+		case 'd':
+			if (sscanf(optarg, "%hx:%hx", &vendor, &product) != 2)
+				usage(*argv);
+			break;
+		case 'E':
+			events = optarg;
+			break;
+		case 'F':
+			if (atusb_rx_filter_parse(optarg, filter))
+				usage(*argv);
+			c.filter = filter;
+			break;
+		case 'H':
+			c.hop_len = atusb_hop_parse(optarg, hop);
+			if (c.hop_len < 0)
+				usage(*argv);
+			c.hop = hop;
+			c.channel = hop[0];
+			break;
+		case 'i':
+			nth = strtoul(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 'n':
+			c.limit = strtoull(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'r':
+			replay = optarg;
+			break;
+		case 'R':
+			raw = optarg;
+			break;
+		case 's':
+			shm = optarg;
+			break;
+		case 'S':
+			slots = strtoul(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 'u':
+			urbs = strtoul(optarg, &end, 0);
+			if (*end || !urbs)
+				usage(*argv);
+			break;
+		default:
+			usage(*argv);
+		}
+	switch (argc-optind) {
+	case 0:
+		if (!shm)
+			output = "-";
+		break;
+	case 1:
+		output = argv[optind];
+		break;
+	default:
+		usage(*argv);
+	}
+	if (output) {
+		out = strcmp(output, "-") ? fopen(output, "wb") : stdout;
+		if (!out) {
+			perror(output);
+			return 1;
+		}
+	}
+	if (replay && (raw || events))
+		usage(*argv);
+	if (events) {
+		c.events = strcmp(events, "-") ? fopen(events, "w") : stderr;
+		if (!c.events) {
+			perror(events);
+			return 1;
+		}
+	}
+	if (raw) {
+		c.raw = fopen(raw, "wb");
+		if (!c.raw) {
+			perror(raw);
+			return 1;
+		}
+	}
+
+	if (out) {
+		c.pcapng = pcapng_open(out);
+		if (!c.pcapng)
+			return 1;
+		c.itf = pcapng_add_if(c.pcapng, "atusb", NULL);
+		if (c.itf < 0)
+			return 1;
+	}
+	c.cs = clksync_new();
+	if (!c.cs)
+		return 1;
+	if (shm) {
+		c.ring = shmring_create(shm, slots);
+		if (!c.ring)
+			return 1;
+	}
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	if (replay)
+		res = capture_replay(&c, replay);
+	else
+		res = capture_usb(&c, vendor, product, nth, urbs);
+
+	clksync_free(c.cs);
+	if (c.ring)
+		shmring_destroy(c.ring);
+	if (c.pcapng && (pcapng_close(c.pcapng) || fclose(out)))
+		res = 1;
+	if (c.raw && fclose(c.raw)) {
+		perror(raw);
+		res = 1;
+	}
+	if (c.events && c.events != stderr && fclose(c.events)) {
+		perror(events);
+		res = 1;
+	}
+	return res;
+}
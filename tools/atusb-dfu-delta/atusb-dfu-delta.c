@@ -0,0 +1,462 @@
+/*
+ * atusb-dfu-delta/atusb-dfu-delta.c - Flash only the pages that changed
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The boot loader reports a CRC for each page of the application. We
+ * announce a delta download, send only the pages whose CRC differs from the
+ * one of the image, using the block number of DFU_DNLOAD as the page number,
+ * and then compare the CRC of the whole image to make sure everything
+ * arrived.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <libusb.h>
+
+#include "atusb/atusb.h"
+#include "atusb/ep0.h"
+
+
+#define	TIMEOUT_MS	5000	/* control transfers */
+#define	DETACH_MS	5000	/* until the boot loader shows up */
+#define	CRC_PAGES	32	/* most pages per ATUSB_FLASH_CRC */
+
+#define	DFU_CLASS	0xfe
+#define	DFU_SUBCLASS	0x01
+#define	DFU_PROTO_RUNTIME 1
+#define	DFU_PROTO_DFU	2
+#define	DFU_DT_FUNCTIONAL 0x21
+
+#define	DFU_TO_DEV	0x21
+#define	DFU_FROM_DEV	0xa1
+
+enum {
+	DFU_DETACH	= 0,
+	DFU_DNLOAD	= 1,
+	DFU_GETSTATUS	= 3,
+};
+
+enum {
+	dfuIDLE		= 2,
+	dfuDNBUSY	= 4,
+	dfuDNLOAD_IDLE	= 5,
+	dfuMANIFEST	= 7,
+};
+
+
+struct dfu_dev {
+	libusb_device_handle *h;
+	int itf;
+	int proto;
+	uint16_t transfer_size;
+};
+
+
+static uint16_t vendor = ATUSB_VENDOR_ID;
+static uint16_t product = ATUSB_PRODUCT_ID;
+static bool verbose = 0;
+
+
+/* ----- CRC --------------------------------------------------------------- */
+
+
+/* same as _crc_ccitt_update in avr-libc */
+
+static uint16_t crc_ccitt(uint16_t crc, const uint8_t *p, size_t len)
+{
+	uint8_t i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i != 8; i++)
+			crc = crc & 1 ? (crc >> 1) ^ 0x8408 : crc >> 1;
+	}
+	return crc;
+}
+
+
+/* ----- Device ------------------------------------------------------------ */
+
+
+static bool find_dfu_itf(libusb_device *dev, struct dfu_dev *d)
+{
+	struct libusb_config_descriptor *cfg;
+	const struct libusb_interface_descriptor *alt;
+	const uint8_t *p;
+	int i, j;
+	bool found = 0;
+
+	if (libusb_get_active_config_descriptor(dev, &cfg))
+		return 0;
+	for (i = 0; i != cfg->bNumInterfaces && !found; i++)
+		for (j = 0; j != cfg->interface[i].num_altsetting; j++) {
+			alt = cfg->interface[i].altsetting+j;
+			if (alt->bInterfaceClass != DFU_CLASS ||
+			    alt->bInterfaceSubClass != DFU_SUBCLASS)
+				continue;
+			d->itf = alt->bInterfaceNumber;
+			d->proto = alt->bInterfaceProtocol;
+			d->transfer_size = 0;
+			for (p = alt->extra; p < alt->extra+alt->extra_length;
+			    p += p[0]) {
+				if (p[0] < 7)
+					break;
+				if (p[1] == DFU_DT_FUNCTIONAL)
+					d->transfer_size = p[5] | p[6] << 8;
+			}
+			found = 1;
+			break;
+		}
+	libusb_free_config_descriptor(cfg);
+	return found;
+}
+
+
+static bool open_dfu(struct dfu_dev *d)
+{
+	libusb_device **list;
+	struct libusb_device_descriptor desc;
+	ssize_t n, i;
+
+	d->h = NULL;
+	n = libusb_get_device_list(NULL, &list);
+	if (n < 0)
+		return 0;
+	for (i = 0; i != n; i++) {
+		if (libusb_get_device_descriptor(list[i], &desc))
+			continue;
+		if (desc.idVendor != vendor || desc.idProduct != product)
+			continue;
+		if (!find_dfu_itf(list[i], d))
+			continue;
+		if (libusb_open(list[i], &d->h))
+			continue;
+		break;
+	}
+	libusb_free_device_list(list, 1);
+	if (!d->h)
+		return 0;
+	libusb_set_auto_detach_kernel_driver(d->h, 1);
+	if (libusb_claim_interface(d->h, d->itf)) {
+		libusb_close(d->h);
+		d->h = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+
+static void close_dfu(struct dfu_dev *d)
+{
+	libusb_release_interface(d->h, d->itf);
+	libusb_close(d->h);
+	d->h = NULL;
+}
+
+
+/*
+ * The application resets into the boot loader after DFU_DETACH and a USB
+ * reset.
+ */
+
+static bool detach(struct dfu_dev *d)
+{
+	int waited;
+
+	if (verbose)
+		fprintf(stderr, "detaching\n");
+	libusb_set_interface_alt_setting(d->h, d->itf, 0);
+	libusb_control_transfer(d->h, DFU_TO_DEV, DFU_DETACH, 1000, d->itf,
+	    NULL, 0, TIMEOUT_MS);
+	libusb_reset_device(d->h);
+	close_dfu(d);
+
+	for (waited = 0; waited < DETACH_MS; waited += 100) {
+		usleep(100*1000);
+		if (open_dfu(d)) {
+			if (d->proto == DFU_PROTO_DFU)
+				return 1;
+			close_dfu(d);
+		}
+	}
+	return 0;
+}
+
+
+/* ----- DFU ------------------------------------------------------------- */
+
+
+static int get_status(struct dfu_dev *d, unsigned *timeout)
+{
+	uint8_t buf[6];
+	int res;
+
+	res = libusb_control_transfer(d->h, DFU_FROM_DEV, DFU_GETSTATUS, 0,
+	    d->itf, buf, sizeof(buf), TIMEOUT_MS);
+	if (res != sizeof(buf)) {
+		fprintf(stderr, "DFU_GETSTATUS: %s\n",
+		    res < 0 ? libusb_error_name(res) : "short reply");
+		return -1;
+	}
+	if (buf[0]) {
+		fprintf(stderr, "DFU status %u, state %u\n", buf[0], buf[4]);
+		return -1;
+	}
+	*timeout = buf[1] | buf[2] << 8 | buf[3] << 16;
+	return buf[4];
+}
+
+
+static bool wait_state(struct dfu_dev *d, int want)
+{
+	unsigned timeout;
+	int state;
+
+	while (1) {
+		state = get_status(d, &timeout);
+		if (state < 0)
+			return 0;
+		if (state == want)
+			return 1;
+		if (state != dfuDNBUSY && state != dfuMANIFEST) {
+			fprintf(stderr, "unexpected DFU state %d\n", state);
+			return 0;
+		}
+		usleep(timeout*1000);
+	}
+}
+
+
+static bool dnload(struct dfu_dev *d, uint16_t block, uint8_t *buf,
+    uint16_t len)
+{
+	int res;
+
+	res = libusb_control_transfer(d->h, DFU_TO_DEV, DFU_DNLOAD, block,
+	    d->itf, buf, len, TIMEOUT_MS);
+	if (res != len) {
+		fprintf(stderr, "DFU_DNLOAD %u: %s\n", block,
+		    res < 0 ? libusb_error_name(res) : "short write");
+		return 0;
+	}
+	return wait_state(d, len ? dfuDNLOAD_IDLE : dfuIDLE);
+}
+
+
+/* ----- Boot loader requests ---------------------------------------------- */
+
+
+static bool page_crcs(struct dfu_dev *d, uint16_t *crc, unsigned pages)
+{
+	uint8_t buf[2*CRC_PAGES];
+	unsigned first, n, i;
+	int res;
+
+	for (first = 0; first < pages; first += n) {
+		n = pages-first > CRC_PAGES ? CRC_PAGES : pages-first;
+		res = libusb_control_transfer(d->h, ATUSB_REQ_FROM_DEV,
+		    ATUSB_FLASH_CRC, 0, first, buf, 2*n, TIMEOUT_MS);
+		if (res != (int) (2*n)) {
+			fprintf(stderr, "ATUSB_FLASH_CRC: %s\n",
+			    res < 0 ? libusb_error_name(res) : "short reply");
+			return 0;
+		}
+		for (i = 0; i != n; i++)
+			crc[first+i] = buf[2*i] | buf[2*i+1] << 8;
+	}
+	return 1;
+}
+
+
+static bool delta_mode(struct dfu_dev *d)
+{
+	int res;
+
+	res = libusb_control_transfer(d->h, ATUSB_REQ_TO_DEV,
+	    ATUSB_FLASH_DELTA, 0, 0, NULL, 0, TIMEOUT_MS);
+	if (res < 0) {
+		fprintf(stderr, "ATUSB_FLASH_DELTA: %s\n",
+		    libusb_error_name(res));
+		return 0;
+	}
+	return 1;
+}
+
+
+static bool image_crc(struct dfu_dev *d, uint32_t len, uint16_t *crc)
+{
+	uint8_t buf[2];
+	int res;
+
+	res = libusb_control_transfer(d->h, ATUSB_REQ_FROM_DEV,
+	    ATUSB_FLASH_IMAGE_CRC, len & 0xffff, len >> 16, buf, 2,
+	    TIMEOUT_MS);
+	if (res != 2) {
+		fprintf(stderr, "ATUSB_FLASH_IMAGE_CRC: %s\n",
+		    res < 0 ? libusb_error_name(res) : "short reply");
+		return 0;
+	}
+	*crc = buf[0] | buf[1] << 8;
+	return 1;
+}
+
+
+/* ----- Image ------------------------------------------------------------- */
+
+
+static uint8_t *load(const char *name, unsigned page, unsigned *pages)
+{
+	FILE *file;
+	uint8_t *buf = NULL;
+	size_t size = 0, got;
+
+	file = fopen(name, "rb");
+	if (!file) {
+		perror(name);
+		return NULL;
+	}
+	while (1) {
+		buf = realloc(buf, size+page);
+		if (!buf) {
+			perror("realloc");
+			exit(1);
+		}
+		got = fread(buf+size, 1, page, file);
+		if (got < page) {
+			memset(buf+size+got, 0xff, page-got);
+			size += got;
+			break;
+		}
+		size += page;
+	}
+	if (ferror(file)) {
+		perror(name);
+		free(buf);
+		buf = NULL;
+	}
+	fclose(file);
+	*pages = (size+page-1)/page;
+	return buf;
+}
+
+
+/* ----- Command line ------------------------------------------------------ */
+
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+"usage: %s [-d vendor:product] [-n] [-v] image.bin\n\n"
+"  -d vendor:product  USB ID of the device (default: %04x:%04x)\n"
+"  -n                 only report which pages would be written\n"
+"  -v                 verbose operation\n"
+    , name, ATUSB_VENDOR_ID, ATUSB_PRODUCT_ID);
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	struct dfu_dev d;
+	uint8_t *image;
+	uint16_t *crc, got_crc;
+	unsigned page, pages, i, written = 0;
+	int last = -1;
+	bool dry_run = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "d:nv")) != EOF)
+		switch (c) {
+		case 'd':
+			if (sscanf(optarg, "%hx:%hx", &vendor, &product) != 2)
+				usage(*argv);
+			break;
+		case 'n':
+			dry_run = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(*argv);
+		}
+	if (argc != optind+1)
+		usage(*argv);
+
+	if (libusb_init(NULL)) {
+		fprintf(stderr, "libusb_init failed\n");
+		return 1;
+	}
+	if (!open_dfu(&d)) {
+		fprintf(stderr, "no DFU device %04x:%04x\n", vendor, product);
+		return 1;
+	}
+	if (d.proto == DFU_PROTO_RUNTIME && !detach(&d)) {
+		fprintf(stderr, "boot loader did not appear\n");
+		return 1;
+	}
+	page = d.transfer_size;
+	if (!page) {
+		fprintf(stderr, "no wTransferSize in DFU descriptor\n");
+		return 1;
+	}
+
+	image = load(argv[optind], page, &pages);
+	if (!image)
+		return 1;
+	crc = malloc(pages*sizeof(*crc));
+	if (!crc) {
+		perror("malloc");
+		return 1;
+	}
+	if (!page_crcs(&d, crc, pages))
+		return 1;
+
+	for (i = 0; i != pages; i++) {
+		if (crc[i] == crc_ccitt(0xffff, image+i*page, page))
+			continue;
+		if (verbose || dry_run)
+			fprintf(stderr, "page %u (0x%05x)\n", i, i*page);
+		if (!dry_run && !written && !delta_mode(&d))
+			return 1;
+		if (!dry_run && !dnload(&d, i, image+i*page, page))
+			return 1;
+		last = i;
+		written++;
+	}
+	if (dry_run) {
+		fprintf(stderr, "%u of %u pages differ\n", written, pages);
+		return 0;
+	}
+	if (last >= 0 && !dnload(&d, last+1, NULL, 0))
+		return 1;
+
+	if (!image_crc(&d, pages*page, &got_crc))
+		return 1;
+	if (got_crc != crc_ccitt(0xffff, image, pages*page)) {
+		fprintf(stderr, "image CRC mismatch (0x%04x)\n", got_crc);
+		return 1;
+	}
+	fprintf(stderr, "%u of %u pages written, image CRC ok\n",
+	    written, pages);
+
+	close_dfu(&d);
+	libusb_exit(NULL);
+	return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * atusb-multicap/atusb-multicap.c - Capture with several devices at once
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Each device gets a thread with its own libusb context, which keeps the
+ * device's transfers in flight, maps the device's timestamps to host time,
+ * and queues the frames. The main thread merges the queues into one pcapng
+ * file, with one interface per device, in the order the frames were
+ * received on the air rather than the order they arrived over USB.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <libusb.h>
+
+#include "atusb/atusb.h"
+
+#include "atusb-dev.h"
+#include "cap.h"
+#include "rec.h"
+#include "clksync.h"
+#include "pcapng.h"
+#include "multicap.h"
+
+
+#define	WINDOW_MS	250	/* default reorder window */
+
+
+volatile sig_atomic_t stop = 0;
+
+static uint16_t vendor = ATUSB_VENDOR_ID, product = ATUSB_PRODUCT_ID;
+static int first = 0;
+static int urbs = ATUSB_CAP_URBS;
+
+
+static void handle_signal(int sig)
+{
+	stop = 1;
+}
+
+
+/* ----- Record processing ------------------------------------------------- */
+
+
+void mc_record(void *user, const uint8_t *buf, int len, uint64_t ns)
+{
+	struct mc_dev *d = user;
+	struct atusb_frame f;
+	struct mc_frame *mf;
+
+	switch (atusb_rec_decode(buf, len, &f)) {
+	case atusb_rec_frame:
+		break;
+	case atusb_rec_bad:
+		d->bad++;
+		return;
+	default:
+		return;
+	}
+
+	mf = malloc(sizeof(*mf));
+	if (!mf) {
+		perror("malloc");
+		exit(1);
+	}
+	memset(&mf->tap, 0, sizeof(mf->tap));
+	mf->tap.has_lqi = 1;
+	mf->tap.lqi = f.lqi;
+	mf->tap.channel = d->channel;
+	if (f.has_trailer) {
+		ns = clksync_wall(d->cs, f.ticks);
+		mf->tap.has_rss = 1;
+		mf->tap.rss = atusb_hw_ed_to_dbm(d->hw_type, f.ed);
+		mf->tap.channel = f.flags & ATUSB_RX_FLAG_CHAN_MASK;
+		mf->tap.crc_known = atusb_frame_crc_known(&f);
+		mf->tap.crc_ok = atusb_frame_crc_ok(&f);
+	}
+
+	/* a refit can move the mapping back a little */
+	if (ns < d->last_ns)
+		ns = d->last_ns;
+	d->last_ns = ns;
+
+	mf->ns = ns;
+	mf->len = f.len;
+	memcpy(mf->psdu, f.psdu, f.len);
+	d->frames++;
+	merge_put(d, mf);
+}
+
+
+/* ----- USB devices ------------------------------------------------------- */
+
+
+static void *usb_thread(void *arg)
+{
+	struct mc_dev *d = arg;
+	libusb_context *ctx;
+	struct atusb_dev *dev;
+	struct atusb_cap *cap;
+	const struct atusb_cap_stats *st;
+	struct timeval tv = { .tv_sec = 0, .tv_usec = 100*1000 };
+	uint64_t next_sync;
+	bool ok = 0;
+
+	if (libusb_init(&ctx)) {
+		fprintf(stderr, "libusb_init failed\n");
+		goto out;
+	}
+	dev = atusb_open(ctx, vendor, product, first+d->index);
+	if (!dev)
+		goto out_exit;
+	d->hw_type = dev->hw_type;
+	if (clksync_measure(d->cs, dev, CLKSYNC_ROUNDS, NULL))
+		goto out_close;
+	cap = atusb_cap_start(ctx, dev, urbs, mc_record, d);
+	if (!cap)
+		goto out_close;
+	if (atusb_rx_start(dev, d->channel, ATUSB_RX_MODE_TRAILER, NULL))
+		goto out_stop;
+
+	next_sync = clksync_mono_ns()+CLKSYNC_INTERVAL_MS*1000000ULL;
+	while (!stop) {
+		libusb_handle_events_timeout(ctx, &tv);
+		if (clksync_mono_ns() < next_sync)
+			continue;
+		if (clksync_measure(d->cs, dev, CLKSYNC_ROUNDS, NULL))
+			break;
+		next_sync += CLKSYNC_INTERVAL_MS*1000000ULL;
+	}
+	ok = stop;
+	atusb_rx_stop(dev);
+
+out_stop:
+	st = atusb_cap_stats(cap);
+	d->usb_errors = st->errors;
+	d->rx_overruns = st->rx_overruns;
+	atusb_cap_stop(cap);
+out_close:
+	atusb_close(dev);
+out_exit:
+	libusb_exit(ctx);
+out:
+	if (!ok) {
+		fprintf(stderr, "device %d failed\n", d->index);
+		stop = 1;
+	}
+	merge_done(d);
+	return NULL;
+}
+
+
+/* ----- Command line ------------------------------------------------------ */
+
+
+static void print_stats(const struct mc_dev *devs, int n, uint64_t late)
+{
+	const struct mc_dev *d;
+
+	for (d = devs; d != devs+n; d++)
+		fprintf(stderr,
+		    "%d: channel %d, %llu frames, %llu bad, %u lost in device, "
+		    "%llu dropped, %llu USB errors, %+.2f ppm\n",
+		    d->index, d->channel, (unsigned long long) d->frames,
+		    (unsigned long long) d->bad, d->rx_overruns,
+		    (unsigned long long) d->dropped,
+		    (unsigned long long) d->usb_errors,
+		    clksync_valid(d->cs) ? clksync_ppm(d->cs) : 0.0);
+	fprintf(stderr, "%llu frames written out of order\n",
+	    (unsigned long long) late);
+}
+
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+"usage: %s [-d vendor:product] [-i first] [-m [-r rate]] [-n count]\n"
+"       %*s [-o file.pcapng] [-q] [-u urbs] [-w window_ms] channel ...\n\n"
+"  -d vendor:product  USB ID of the devices (default: %04x:%04x)\n"
+"  -i first           index of the first device to use (default: 0)\n"
+"  -m                 use simulated devices instead of real ones\n"
+"  -n count           stop after that many frames\n"
+"  -o file.pcapng     output file (default: standard output)\n"
+"  -q                 don't print statistics\n"
+"  -r rate            frames per second per simulated device (default: %u)\n"
+"  -u urbs            number of USB transfers in flight per device\n"
+"                     (default: %d)\n"
+"  -w window_ms       how long to wait for earlier frames (default: %d)\n"
+"  channel            one channel, 11 to 26, per device\n"
+    , name, (int) strlen(name), "", ATUSB_VENDOR_ID, ATUSB_PRODUCT_ID,
+    mock_rate, ATUSB_CAP_URBS, WINDOW_MS);
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	struct mc_dev *devs, *d;
+	struct pcapng *p;
+	const char *output = NULL;
+	uint64_t limit = 0, late = 0;
+	unsigned window_ms = WINDOW_MS;
+	bool mock = 0, quiet = 0;
+	FILE *out = stdout;
+	char descr[20];
+	char *end;
+	int n, i, opt, res;
+
+	while ((opt = getopt(argc, argv, "d:i:mn:o:qr:u:w:")) != EOF)
+		switch (opt) {
+		case 'd':
+			if (sscanf(optarg, "%hx:%hx", &vendor, &product) != 2)
+				usage(*argv);
+			break;
+		case 'i':
+			first = strtoul(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 'm':
+			mock = 1;
+			break;
+		case 'n':
+			limit = strtoull(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'r':
+			mock_rate = strtoul(optarg, &end, 0);
+			if (*end || !mock_rate)
+				usage(*argv);
+			break;
+		case 'u':
+			urbs = strtoul(optarg, &end, 0);
+			if (*end || !urbs)
+				usage(*argv);
+			break;
+		case 'w':
+			window_ms = strtoul(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		default:
+			usage(*argv);
+		}
+	n = argc-optind;
+	if (!n || n > MC_MAX_DEVS)
+		usage(*argv);
+
+	devs = calloc(n, sizeof(*devs));
+	if (!devs) {
+		perror("calloc");
+		return 1;
+	}
+	for (i = 0; i != n; i++) {
+		d = devs+i;
+		d->channel = strtoul(argv[optind+i], &end, 0);
+		if (*end || d->channel < 11 || d->channel > 26)
+			usage(*argv);
+		d->cs = clksync_new();
+		if (!d->cs)
+			return 1;
+	}
+
+	if (output && strcmp(output, "-")) {
+		out = fopen(output, "wb");
+		if (!out) {
+			perror(output);
+			return 1;
+		}
+	}
+	p = pcapng_open(out);
+	if (!p)
+		return 1;
+	for (i = 0; i != n; i++) {
+		sprintf(descr, "channel %d", devs[i].channel);
+		devs[i].index = pcapng_add_if(p, "atusb", descr);
+		if (devs[i].index < 0)
+			return 1;
+	}
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	for (d = devs; d != devs+n; d++)
+		if (pthread_create(&d->thread, NULL,
+		    mock ? mock_thread : usb_thread, d)) {
+			perror("pthread_create");
+			stop = 1;
+			n = d-devs;
+			break;
+		}
+
+	res = merge_run(devs, n, p, window_ms*1000000ULL, limit, &late) < 0;
+
+	for (d = devs; d != devs+n; d++)
+		pthread_join(d->thread, NULL);
+	if (!quiet)
+		print_stats(devs, n, late);
+	if (pcapng_close(p) || fclose(out))
+		res = 1;
+	for (d = devs; d != devs+n; d++)
+		clksync_free(d->cs);
+	free(devs);
+	return res;
+}
@@ -0,0 +1,150 @@
+/*
+ * atusb-multicap/merge.c - Merge the devices' frames in time order
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Each device queues its frames in the order of its own clock, which clksync
+ * maps to host time. Merging the queues is therefore a k-way merge of sorted
+ * lists, except that a device may not have delivered its next frame yet. We
+ * only write the earliest head if no device can still come up with an
+ * earlier one: either all devices have something queued, or the frame is
+ * older than the reorder window, which has to cover USB latency and the
+ * error of the clock mapping. Frames that arrive later than that are still
+ * written, but counted as late.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cap.h"
+#include "pcapng.h"
+#include "multicap.h"
+
+
+#define	MAX_QUEUED	100000	/* frames per device */
+#define	IDLE_MS		10	/* re-check the window at least this often */
+
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t more = PTHREAD_COND_INITIALIZER;
+
+
+void merge_put(struct mc_dev *d, struct mc_frame *f)
+{
+	f->next = NULL;
+	pthread_mutex_lock(&lock);
+	if (d->queued == MAX_QUEUED) {
+		pthread_mutex_unlock(&lock);
+		d->dropped++;
+		free(f);
+		return;
+	}
+	if (d->head)
+		d->tail->next = f;
+	else
+		d->head = f;
+	d->tail = f;
+	d->queued++;
+	pthread_cond_signal(&more);
+	pthread_mutex_unlock(&lock);
+}
+
+
+void merge_done(struct mc_dev *d)
+{
+	pthread_mutex_lock(&lock);
+	d->done = 1;
+	pthread_cond_signal(&more);
+	pthread_mutex_unlock(&lock);
+}
+
+
+static void wait_more(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += IDLE_MS*1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait(&more, &lock, &ts);
+}
+
+
+int merge_run(struct mc_dev *devs, int n, struct pcapng *p,
+    uint64_t window_ns, uint64_t limit, uint64_t *late)
+{
+	struct mc_dev *best, *d;
+	struct mc_frame *f;
+	uint64_t written = 0, last = 0;
+	bool all, alive;
+	int res = 0;
+
+	pthread_mutex_lock(&lock);
+	while (1) {
+		best = NULL;
+		all = 1;
+		alive = 0;
+		for (d = devs; d != devs+n; d++) {
+			if (!d->done)
+				alive = 1;
+			if (d->head) {
+				if (!best || d->head->ns < best->head->ns)
+					best = d;
+			} else if (!d->done) {
+				all = 0;
+			}
+		}
+		if (!best) {
+			if (!alive)
+				break;
+			wait_more();
+			continue;
+		}
+		if (!all && best->head->ns+window_ns > atusb_host_ns()) {
+			wait_more();
+			continue;
+		}
+
+		f = best->head;
+		best->head = f->next;
+		best->queued--;
+		pthread_mutex_unlock(&lock);
+
+		/* past the limit or an error, we just drain the queues */
+		if (!res && (!limit || written < limit)) {
+			if (f->ns < last)
+				(*late)++;
+			else
+				last = f->ns;
+			if (pcapng_packet(p, best->index, f->ns, f->psdu,
+			    f->len, &f->tap)) {
+				res = -1;
+				stop = 1;
+			}
+			if (++written == limit)
+				stop = 1;
+		}
+		free(f);
+
+		pthread_mutex_lock(&lock);
+	}
+	pthread_mutex_unlock(&lock);
+	return res;
+}
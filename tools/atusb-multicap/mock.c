@@ -0,0 +1,181 @@
+/*
+ * atusb-multicap/mock.c - Simulated devices for testing without hardware
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * A mock device stands in for the USB side of one device's thread. It has
+ * its own crystal error and start time, "receives" frames at random
+ * intervals, and answers clock sync requests with a random round trip. Its
+ * records go through the same decoding, clock mapping, and merging as those
+ * of a real device.
+ *
+ * The frames are broadcast data frames from short address "index", with a
+ * sequence number and, in the payload, a 64-bit frame counter.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "atusb/atusb.h"
+
+#include "cap.h"
+#include "rec.h"
+#include "clksync.h"
+#include "multicap.h"
+
+
+#define	MAX_PPM		50		/* crystal error */
+#define	MIN_RTT_NS	200000		/* clock sync round trip */
+#define	MAX_RTT_NS	1200000
+#define	PSDU_LEN	19
+
+
+unsigned mock_rate = 100;
+
+
+struct mock {
+	struct mc_dev *d;
+	unsigned seed;
+	double ppm;
+	uint64_t tick0, mono0;
+	uint64_t count;
+};
+
+
+static double uniform(struct mock *m)
+{
+	return (rand_r(&m->seed)+1.0)/(RAND_MAX+2.0);
+}
+
+
+static uint64_t ticks_at(const struct mock *m, uint64_t mono)
+{
+	return m->tick0+
+	    llround((mono-m->mono0)/(double) ATUSB_NS_PER_TICK*
+	    (1+m->ppm*1e-6));
+}
+
+
+static void mock_sync(struct mock *m, uint64_t now)
+{
+	struct clksync_sample s;
+	uint64_t rtt;
+
+	rtt = MIN_RTT_NS+uniform(m)*(MAX_RTT_NS-MIN_RTT_NS);
+	s.mono0 = now;
+	s.mono1 = now+rtt;
+	s.ticks = ticks_at(m, now+rtt*(0.3+0.4*uniform(m)));
+	s.wall_off = atusb_host_ns()-clksync_mono_ns();
+	clksync_add(m->d->cs, &s);
+}
+
+
+static uint16_t crc_ccitt(const uint8_t *p, int len)
+{
+	uint16_t crc = 0;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i != 8; i++)
+			crc = crc & 1 ? crc >> 1 ^ 0x8408 : crc >> 1;
+	}
+	return crc;
+}
+
+
+static void mock_frame(struct mock *m, uint64_t at)
+{
+	uint8_t rec[1+PSDU_LEN+1+ATUSB_RX_TRAILER_SIZE];
+	uint8_t *p = rec+1;
+	uint64_t ticks;
+	uint16_t crc;
+	int i;
+
+	rec[0] = PSDU_LEN;
+	*p++ = 0x41;			/* data, PAN ID compression */
+	*p++ = 0x88;			/* short addresses */
+	*p++ = m->count;
+	*p++ = 0xef;			/* PAN 0xbeef */
+	*p++ = 0xbe;
+	*p++ = 0xff;			/* to 0xffff */
+	*p++ = 0xff;
+	*p++ = m->d->index;		/* from index */
+	*p++ = 0;
+	for (i = 0; i != 8; i++)
+		*p++ = m->count >> 8*i;
+	crc = crc_ccitt(rec+1, PSDU_LEN-2);
+	*p++ = crc;
+	*p++ = crc >> 8;
+	*p++ = 0xff;			/* LQI */
+
+	ticks = ticks_at(m, at);
+	*p++ = 20+rand_r(&m->seed) % 40;	/* ED */
+	*p++ = ATUSB_RX_FLAG_CRC_VALID | ATUSB_RX_FLAG_CRC_KNOWN |
+	    m->d->channel;
+	for (i = 0; i != 6; i++)
+		*p++ = ticks >> 8*i;
+
+	m->count++;
+	mc_record(m->d, rec, sizeof(rec), atusb_host_ns());
+}
+
+
+static void sleep_until(uint64_t mono)
+{
+	struct timespec ts = {
+		.tv_sec = mono/1000000000,
+		.tv_nsec = mono % 1000000000,
+	};
+
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+
+void *mock_thread(void *arg)
+{
+	struct mock m = {
+		.d = arg,
+	};
+	uint64_t now, next_frame, next_sync;
+
+	m.seed = m.d->index*7919+1;
+	m.ppm = (2*uniform(&m)-1)*MAX_PPM;
+	m.tick0 = rand_r(&m.seed);
+	m.mono0 = clksync_mono_ns();
+	m.d->hw_type = ATUSB_HW_TYPE_110131;
+
+	now = m.mono0;
+	mock_sync(&m, now);
+	next_sync = now+CLKSYNC_INTERVAL_MS*1000000ULL;
+	next_frame = now;
+	while (!stop) {
+		now = clksync_mono_ns();
+		if (now >= next_sync) {
+			mock_sync(&m, now);
+			next_sync += CLKSYNC_INTERVAL_MS*1000000ULL;
+		}
+		if (now < next_frame) {
+			sleep_until(next_frame < next_sync ?
+			    next_frame : next_sync);
+			continue;
+		}
+		mock_frame(&m, next_frame);
+		next_frame += -log(uniform(&m))/mock_rate*1e9;
+	}
+	merge_done(m.d);
+	return NULL;
+}
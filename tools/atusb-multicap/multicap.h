@@ -0,0 +1,89 @@
+/*
+ * atusb-multicap/multicap.h - Capture with several devices at once
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef MULTICAP_H
+#define	MULTICAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "clksync.h"
+#include "pcapng.h"
+
+
+#define	MC_MAX_DEVS	64
+
+
+struct mc_frame {
+	struct mc_frame *next;
+	uint64_t ns;		/* host wall time */
+	struct pcapng_tap tap;
+	uint8_t len;
+	uint8_t psdu[127];
+};
+
+struct mc_dev {
+	int index;		/* USB device and pcapng interface */
+	int channel;
+	pthread_t thread;
+	struct clksync *cs;
+	uint8_t hw_type;
+
+	/* frames waiting to be merged, protected by the merge lock */
+	struct mc_frame *head, *tail;
+	unsigned queued;
+	bool done;		/* the device's thread has finished */
+
+	/* only touched by the device's thread */
+	uint64_t last_ns;
+
+	/* statistics, read after the device's thread has finished */
+	uint64_t frames, bad, dropped;
+	uint64_t usb_errors;
+	uint32_t rx_overruns;
+};
+
+
+extern volatile sig_atomic_t stop;
+
+
+/* decode one EP 1 record and queue the frame, if it is one */
+void mc_record(void *user, const uint8_t *buf, int len, uint64_t ns);
+
+
+/* ----- merge.c ----------------------------------------------------------- */
+
+/* queue a frame, or drop it if too many are waiting */
+void merge_put(struct mc_dev *d, struct mc_frame *f);
+
+/* called by the device's thread when it has no more frames */
+void merge_done(struct mc_dev *d);
+
+/*
+ * Write the frames of all devices in time order, holding each one back until
+ * either every other device has a later one queued or the frame is older than
+ * "window_ns", until all devices are done or "limit" frames have been written.
+ */
+int merge_run(struct mc_dev *devs, int n, struct pcapng *p,
+    uint64_t window_ns, uint64_t limit, uint64_t *late);
+
+
+/* ----- mock.c ------------------------------------------------------------ */
+
+/* frames per second and device */
+extern unsigned mock_rate;
+
+void *mock_thread(void *arg);
+
+#endif /* !MULTICAP_H */
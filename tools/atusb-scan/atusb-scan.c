@@ -0,0 +1,241 @@
+/*
+ * atusb-scan/atusb-scan.c - Survey channel occupancy with the ED scan engine
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The device does the sampling and only sends us one summary per channel
+ * and sweep, on the telemetry endpoint.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <libusb.h>
+
+#include "atusb/atusb.h"
+
+#include "atusb-dev.h"
+#include "telem.h"
+
+
+#define	SAMPLES		100	/* default per channel and sweep */
+#define	POLL_MS		100
+
+
+struct scan {
+	uint8_t hw_type;
+	unsigned channels;	/* per sweep */
+	unsigned long long records, limit;
+	uint32_t dropped;
+};
+
+
+static volatile sig_atomic_t stop = 0;
+
+
+static void handle_signal(int sig)
+{
+	stop = 1;
+}
+
+
+static void record(void *user, uint8_t type, const uint8_t *buf,
+    uint8_t len)
+{
+	struct scan *s = user;
+	uint16_t n, count;
+	int i;
+
+	switch (type) {
+	case ATUSB_TELEM_DROPPED:
+		if (len >= 2)
+			s->dropped += buf[0] | buf[1] << 8;
+		return;
+	case ATUSB_TELEM_SCAN:
+		break;
+	default:
+		return;
+	}
+	if (len < ATUSB_SCAN_REC_SIZE)
+		return;
+
+	n = buf[4] | buf[5] << 8;
+	printf("%2u %6.1f %6.1f %6.1f %5u ", buf[0],
+	    atusb_hw_ed_to_dbm(s->hw_type, buf[1]),
+	    atusb_hw_ed_to_dbm(s->hw_type, buf[2]),
+	    atusb_hw_ed_to_dbm(s->hw_type, buf[3]), n);
+	for (i = 0; i != ATUSB_SCAN_BINS; i++) {
+		count = buf[6+2*i] | buf[7+2*i] << 8;
+		printf(" %3u", n ? 100*count/n : 0);
+	}
+	printf("\n");
+	fflush(stdout);
+
+	if (++s->records == s->limit)
+		stop = 1;
+}
+
+
+static int calibrate(struct atusb_dev *dev, uint16_t mask, int first)
+{
+	uint8_t latency[16];
+	int n, i;
+
+	n = atusb_chan_cal(dev, mask, latency, sizeof(latency));
+	if (n < 0)
+		return -1;
+	for (i = 0; i != n; i++) {
+		if (!(mask & 1 << i))
+			continue;
+		switch (latency[i]) {
+		case ATUSB_CHAN_UNKNOWN:
+			printf("# channel %2d: not calibrated\n", first+i);
+			break;
+		case ATUSB_CHAN_FAILED:
+			printf("# channel %2d: calibration failed\n", first+i);
+			break;
+		default:
+			printf("# channel %2d: PLL lock in %u us\n", first+i,
+			    latency[i]);
+			break;
+		}
+	}
+	return 0;
+}
+
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+"usage: %s [-c] [-d vendor:product] [-i index] [-n sweeps] [-s samples]\n"
+"       %*s [channel ...]\n\n"
+"  -c                 calibrate the channels first and show their switch time\n"
+"  -d vendor:product  USB ID of the device (default: %04x:%04x)\n"
+"  -i index           use the index-th matching device (default: 0)\n"
+"  -n sweeps          stop after that many sweeps\n"
+"  -s samples         ED samples per channel and sweep (default: %d)\n"
+"  channel            channel to scan (default: all)\n\n"
+"Prints the channel, minimum, maximum, and mean level in dBm, the number of\n"
+"samples, and the percentage of samples in each %d dB range, from the\n"
+"sensitivity limit up.\n"
+    , name, (int) strlen(name), "", ATUSB_VENDOR_ID, ATUSB_PRODUCT_ID,
+    SAMPLES, 1 << ATUSB_SCAN_BIN_SHIFT);
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	uint16_t vendor = ATUSB_VENDOR_ID, product = ATUSB_PRODUCT_ID;
+	struct scan s;
+	struct atusb_telem t;
+	libusb_context *ctx;
+	struct atusb_dev *dev;
+	unsigned long sweeps = 0, samples = SAMPLES, chan;
+	uint16_t mask = 0;
+	uint8_t buf[512];
+	char *end;
+	bool cal = 0;
+	int nth = 0, opt, got, first, res = 1;
+	int i;
+
+	while ((opt = getopt(argc, argv, "cd:i:n:s:")) != EOF)
+		switch (opt) {
+		case 'c':
+			cal = 1;
+			break;
+		case 'd':
+			if (sscanf(optarg, "%hx:%hx", &vendor, &product) != 2)
+				usage(*argv);
+			break;
+		case 'i':
+			nth = strtoul(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 'n':
+			sweeps = strtoul(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		case 's':
+			samples = strtoul(optarg, &end, 0);
+			if (*end || !samples || samples > 0xffff)
+				usage(*argv);
+			break;
+		default:
+			usage(*argv);
+		}
+
+	if (libusb_init(&ctx)) {
+		fprintf(stderr, "libusb_init failed\n");
+		return 1;
+	}
+	dev = atusb_open(ctx, vendor, product, nth);
+	if (!dev)
+		goto out_exit;
+
+	first = dev->hw_type == ATUSB_HW_TYPE_HULUSB ? 0 : 11;
+	for (i = optind; i != argc; i++) {
+		chan = strtoul(argv[i], &end, 0);
+		if (*end || chan < (unsigned) first ||
+		    chan > (first ? 26 : 10))
+			usage(*argv);
+		mask |= 1 << (chan-first);
+	}
+	if (!mask)
+		mask = first ? 0xffff : (1 << 11)-1;
+
+	memset(&s, 0, sizeof(s));
+	s.hw_type = dev->hw_type;
+	for (i = 0; i != 16; i++)
+		if (mask & 1 << i)
+			s.channels++;
+	s.limit = sweeps*s.channels;
+	memset(&t, 0, sizeof(t));
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	if (cal && calibrate(dev, mask, first))
+		goto out_close;
+	if (atusb_scan(dev, mask, samples))
+		goto out_close;
+	printf("#ch    min    max   mean     n   ED bins (%%)\n");
+	while (!stop) {
+		switch (libusb_bulk_transfer(dev->h, ATUSB_EP_TELEM, buf,
+		    sizeof(buf), &got, POLL_MS)) {
+		case 0:
+		case LIBUSB_ERROR_TIMEOUT:
+			atusb_telem_feed(&t, buf, got, record, &s);
+			break;
+		default:
+			fprintf(stderr, "telemetry endpoint failed\n");
+			stop = 1;
+			continue;
+		}
+	}
+	res = atusb_scan(dev, 0, 0) != 0;
+	if (s.dropped)
+		fprintf(stderr, "%u summaries lost in device\n", s.dropped);
+
+out_close:
+	atusb_close(dev);
+out_exit:
+	libusb_exit(ctx);
+	return res;
+}
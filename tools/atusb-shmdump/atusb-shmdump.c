@@ -0,0 +1,118 @@
+/*
+ * atusb-shmdump/atusb-shmdump.c - Print the frames in a shared-memory ring
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * A minimal consumer of the ring atusb-cap -s publishes, and an example of
+ * how to use the reader side of shmring.h.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "shmring.h"
+
+
+#define	IDLE_US		1000	/* poll interval when the ring is empty */
+
+
+static volatile sig_atomic_t stop = 0;
+
+
+static void handle_signal(int sig)
+{
+	stop = 1;
+}
+
+
+static void print_frame(const struct shmring_frame *f)
+{
+	uint8_t i;
+
+	printf("%llu.%09llu %u %2u %3u %3u",
+	    (unsigned long long) (f->ns/1000000000),
+	    (unsigned long long) (f->ns % 1000000000),
+	    f->itf, f->channel, f->len, f->lqi);
+	if (f->flags & SHMRING_F_TRAILER)
+		printf(" %4.0f", f->rss);
+	else
+		printf("    -");
+	if (f->flags & SHMRING_F_CRC_KNOWN)
+		printf(f->flags & SHMRING_F_CRC_OK ? "   ok" : "  bad");
+	else
+		printf("    -");
+	for (i = 0; i != f->len; i++)
+		printf("%s%02x", i ? "" : " ", f->psdu[i]);
+}
+
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-n count] name\n\n"
+"  -n count  stop after that many frames\n"
+"  name      shared memory object, as given to atusb-cap -s\n", name);
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	struct shmring_reader *r;
+	const struct shmring_frame *f;
+	unsigned long long count = 0, limit = 0;
+	char *end;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:")) != EOF)
+		switch (c) {
+		case 'n':
+			limit = strtoull(optarg, &end, 0);
+			if (*end)
+				usage(*argv);
+			break;
+		default:
+			usage(*argv);
+		}
+	if (argc != optind+1)
+		usage(*argv);
+
+	r = shmring_attach(argv[optind]);
+	if (!r)
+		return 1;
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	printf("# time itf chan len lqi rss crc psdu\n");
+	while (!stop) {
+		f = shmring_next(r);
+		if (!f) {
+			if (!shmring_alive(r))
+				break;
+			fflush(stdout);
+			usleep(IDLE_US);
+			continue;
+		}
+		print_frame(f);
+		printf(shmring_done(r) ? "\n" : " (overwritten)\n");
+		if (++count == limit)
+			break;
+	}
+	fprintf(stderr, "%llu frames, %llu lost\n", count,
+	    (unsigned long long) shmring_overruns(r));
+	shmring_detach(r);
+	return 0;
+}
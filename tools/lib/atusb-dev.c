@@ -0,0 +1,515 @@
+/*
+ * lib/atusb-dev.c - Open and configure an ATUSB through libusb
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <libusb.h>
+
+#include "at86rf230.h"
+#include "atusb/atusb.h"
+#include "atusb/ep0.h"
+
+#include "atusb-dev.h"
+
+
+static int req_out_buf(struct atusb_dev *dev, uint8_t req, uint16_t value,
+    uint16_t index, void *buf, uint16_t len)
+{
+	int res;
+
+	res = libusb_control_transfer(dev->h, ATUSB_REQ_TO_DEV, req, value,
+	    index, buf, len, ATUSB_TIMEOUT_MS);
+	if (res < 0) {
+		fprintf(stderr, "request 0x%02x: %s\n", req,
+		    libusb_error_name(res));
+		return -1;
+	}
+	return 0;
+}
+
+
+static int req_out(struct atusb_dev *dev, uint8_t req, uint16_t value,
+    uint16_t index)
+{
+	return req_out_buf(dev, req, value, index, NULL, 0);
+}
+
+
+static int req_in(struct atusb_dev *dev, uint8_t req, uint16_t value,
+    uint16_t index, void *buf, uint16_t len)
+{
+	int res;
+
+	res = libusb_control_transfer(dev->h, ATUSB_REQ_FROM_DEV, req, value,
+	    index, buf, len, ATUSB_TIMEOUT_MS);
+	if (res < 0) {
+		fprintf(stderr, "request 0x%02x: %s\n", req,
+		    libusb_error_name(res));
+		return -1;
+	}
+	return res;
+}
+
+
+struct atusb_dev *atusb_open(libusb_context *ctx, uint16_t vendor,
+    uint16_t product, int nth)
+{
+	libusb_device **list;
+	struct libusb_device_descriptor desc;
+	struct atusb_dev *dev = NULL;
+	libusb_device_handle *h = NULL;
+	uint8_t id[3];
+	ssize_t n, i;
+
+	n = libusb_get_device_list(ctx, &list);
+	if (n < 0) {
+		fprintf(stderr, "libusb_get_device_list: %s\n",
+		    libusb_error_name(n));
+		return NULL;
+	}
+	for (i = 0; i != n; i++) {
+		if (libusb_get_device_descriptor(list[i], &desc))
+			continue;
+		if (desc.idVendor != vendor || desc.idProduct != product)
+			continue;
+		if (nth--)
+			continue;
+		if (libusb_open(list[i], &h))
+			h = NULL;
+		break;
+	}
+	if (h) {
+		dev = calloc(1, sizeof(*dev));
+		if (!dev) {
+			perror("calloc");
+			exit(1);
+		}
+		dev->h = h;
+		dev->bus = libusb_get_bus_number(list[i]);
+		dev->addr = libusb_get_device_address(list[i]);
+	}
+	libusb_free_device_list(list, 1);
+	if (!dev) {
+		fprintf(stderr, "no device %04x:%04x\n", vendor, product);
+		return NULL;
+	}
+
+	libusb_set_auto_detach_kernel_driver(h, 1);
+	if (libusb_claim_interface(h, 0)) {
+		fprintf(stderr, "cannot claim interface\n");
+		goto fail;
+	}
+	if (req_in(dev, ATUSB_ID, 0, 0, id, sizeof(id)) != sizeof(id))
+		goto fail;
+	dev->major = id[0];
+	dev->minor = id[1];
+	dev->hw_type = id[2];
+	return dev;
+
+fail:
+	libusb_close(h);
+	free(dev);
+	return NULL;
+}
+
+
+void atusb_close(struct atusb_dev *dev)
+{
+	libusb_release_interface(dev->h, 0);
+	libusb_close(dev->h);
+	free(dev);
+}
+
+
+int atusb_reg_write(struct atusb_dev *dev, uint8_t reg, uint8_t value)
+{
+	return req_out(dev, ATUSB_REG_WRITE, value, reg);
+}
+
+
+int atusb_reg_read(struct atusb_dev *dev, uint8_t reg)
+{
+	uint8_t value;
+
+	if (req_in(dev, ATUSB_REG_READ, 0, reg, &value, 1) != 1)
+		return -1;
+	return value;
+}
+
+
+int atusb_timer(struct atusb_dev *dev, uint64_t *ticks)
+{
+	uint8_t buf[8];
+	int i;
+
+	if (req_in(dev, ATUSB_TIMER, 0, 0, buf, 6) != 6)
+		return -1;
+	*ticks = 0;
+	for (i = 5; i >= 0; i--)
+		*ticks = *ticks << 8 | buf[i];
+	return 0;
+}
+
+
+static int reg_set(struct atusb_dev *dev, uint8_t reg, uint8_t bits)
+{
+	int value;
+
+	value = atusb_reg_read(dev, reg);
+	if (value < 0)
+		return -1;
+	return atusb_reg_write(dev, reg, value | bits);
+}
+
+
+int atusb_rx_start(struct atusb_dev *dev, int channel, uint16_t flags,
+    const uint8_t *filter)
+{
+	int cc;
+
+	if (req_out(dev, ATUSB_RF_RESET, 0, 0))
+		return -1;
+	if (atusb_reg_write(dev, REG_TRX_STATE, TRX_CMD_TRX_OFF))
+		return -1;
+	cc = atusb_reg_read(dev, REG_PHY_CC_CCA);
+	if (cc < 0)
+		return -1;
+	if (atusb_reg_write(dev, REG_PHY_CC_CCA,
+	    (cc & ~CHANNEL_MASK) | channel))
+		return -1;
+	/* RX_START is what the attacks hook into */
+	if (atusb_reg_write(dev, REG_IRQ_MASK, IRQ_TRX_END | IRQ_RX_START))
+		return -1;
+	/*
+	 * Take frames for any destination and of any version, and don't ACK
+	 * them. The AT86RF230 has no promiscuous mode.
+	 */
+	if (dev->hw_type != ATUSB_HW_TYPE_RZUSB) {
+		if (reg_set(dev, REG_XAH_CTRL_1, AACK_PROM_MODE))
+			return -1;
+		if (reg_set(dev, REG_CSMA_SEED_1, AACK_DIS_ACK |
+		    AACK_FVN_MODE_ANY << AACK_FVN_MODE_SHIFT))
+			return -1;
+	}
+	/* ATUSB_RF_RESET has turned the filter off */
+	if (filter && atusb_rx_filter(dev, filter))
+		return -1;
+	return req_out(dev, ATUSB_RX_MODE, ATUSB_RX_MODE_ON | flags, 0);
+}
+
+
+int atusb_rx_filter(struct atusb_dev *dev, const uint8_t *filter)
+{
+	uint8_t buf[ATUSB_RX_FILTER_SIZE];
+
+	if (!filter)
+		return req_out(dev, ATUSB_RX_FILTER, 0, 0);
+	memcpy(buf, filter, sizeof(buf));
+	return req_out_buf(dev, ATUSB_RX_FILTER, 0, 0, buf, sizeof(buf));
+}
+
+
+int atusb_scan(struct atusb_dev *dev, uint16_t channels, uint16_t samples)
+{
+	return req_out(dev, ATUSB_SCAN, channels, samples);
+}
+
+
+int atusb_chan_cal(struct atusb_dev *dev, uint16_t channels, uint8_t *latency,
+    int size)
+{
+	return req_in(dev, ATUSB_CHAN_CAL, channels, 0, latency, size);
+}
+
+
+int atusb_hop(struct atusb_dev *dev, const uint8_t *sched, int len)
+{
+	uint8_t buf[ATUSB_HOP_SLOTS*ATUSB_HOP_ENTRY_SIZE];
+
+	if (!len)
+		return req_out(dev, ATUSB_HOP, 0, 0);
+	if (len > (int) sizeof(buf))
+		return -1;
+	memcpy(buf, sched, len);
+	return req_out_buf(dev, ATUSB_HOP, 0, 0, buf, len);
+}
+
+
+int atusb_template(struct atusb_dev *dev, uint8_t slot, const uint8_t *psdu,
+    int len)
+{
+	uint8_t buf[MAX_PSDU];
+
+	if (!len)
+		return req_out(dev, ATUSB_TEMPLATE, slot, 0);
+	if (len > MAX_PSDU-2)
+		return -1;
+	memcpy(buf, psdu, len);
+	return req_out_buf(dev, ATUSB_TEMPLATE, slot, 0, buf, len);
+}
+
+
+int atusb_tx_template(struct atusb_dev *dev, uint8_t slot, uint8_t seq,
+    const uint8_t *patch, int len)
+{
+	uint8_t buf[MAX_PSDU];
+
+	if (!len)
+		return req_out(dev, ATUSB_TX_TEMPLATE, slot, seq);
+	if (len > MAX_PSDU)
+		return -1;
+	memcpy(buf, patch, len);
+	return req_out_buf(dev, ATUSB_TX_TEMPLATE, slot, seq, buf, len);
+}
+
+
+int atusb_tx_at(struct atusb_dev *dev, uint64_t ticks, uint8_t seq,
+    const uint8_t *psdu, int len)
+{
+	uint8_t buf[ATUSB_TX_AT_TIME_SIZE+MAX_PSDU-2];
+	int i;
+
+	if (len > MAX_PSDU-2)
+		return -1;
+	for (i = 0; i != ATUSB_TX_AT_TIME_SIZE; i++) {
+		buf[i] = ticks;
+		ticks >>= 8;
+	}
+	memcpy(buf+ATUSB_TX_AT_TIME_SIZE, psdu, len);
+	return req_out_buf(dev, ATUSB_TX_AT, 0, seq, buf,
+	    ATUSB_TX_AT_TIME_SIZE+len);
+}
+
+
+int atusb_rx_stats(struct atusb_dev *dev, struct atusb_rx_stats *st)
+{
+	uint8_t buf[ATUSB_RX_STATS_SIZE];
+	int i;
+
+	if (req_in(dev, ATUSB_RX_STATS, 0, 0, buf, sizeof(buf)) !=
+	    sizeof(buf))
+		return -1;
+	st->frames = st->filtered = 0;
+	for (i = 3; i >= 0; i--) {
+		st->frames = st->frames << 8 | buf[i];
+		st->filtered = st->filtered << 8 | buf[4+i];
+	}
+	st->overruns = buf[8] | buf[9] << 8;
+	return 0;
+}
+
+
+int atusb_bench(struct atusb_dev *dev, uint8_t primitive, uint8_t bytes,
+    struct atusb_bench_result *res)
+{
+	uint8_t buf[ATUSB_BENCH_REC_SIZE];
+
+	if (req_in(dev, ATUSB_BENCH, primitive, bytes, buf, sizeof(buf)) !=
+	    sizeof(buf))
+		return -1;
+	res->min = buf[0] | buf[1] << 8;
+	res->mean = buf[2] | buf[3] << 8;
+	res->max = buf[4] | buf[5] << 8;
+	res->errors = buf[6] | buf[7] << 8;
+	return 0;
+}
+
+
+int atusb_rx_stop(struct atusb_dev *dev)
+{
+	return req_out(dev, ATUSB_RX_MODE, 0, 0);
+}
+
+
+/*
+ * RSSI_BASE_VAL from the data sheets. For the AT86RF212 it depends on the
+ * PHY mode; we use the one of the O-QPSK modes.
+ */
+
+float atusb_hw_ed_to_dbm(uint8_t hw_type, uint8_t ed)
+{
+	switch (hw_type) {
+	case ATUSB_HW_TYPE_HULUSB:
+		return -98+ed;
+	default:
+		return -91+ed;
+	}
+}
+
+
+float atusb_ed_to_dbm(const struct atusb_dev *dev, uint8_t ed)
+{
+	return atusb_hw_ed_to_dbm(dev->hw_type, ed);
+}
+
+
+/* ----- Filter descriptions ----------------------------------------------- */
+
+
+static const char *frame_types[] = { "beacon", "data", "ack", "cmd" };
+
+
+static bool parse_types(const char *s, uint8_t *types)
+{
+	unsigned long n;
+	char *end;
+	size_t len;
+	int i;
+
+	*types = 0;
+	while (1) {
+		len = strcspn(s, "+,");
+		for (i = 0; i != 4; i++)
+			if (strlen(frame_types[i]) == len &&
+			    !strncmp(s, frame_types[i], len))
+				break;
+		if (i == 4) {
+			n = strtoul(s, &end, 0);
+			if (end != s+len || n > 7)
+				return 0;
+			i = n;
+		}
+		*types |= 1 << i;
+		s += len;
+		if (*s != '+')
+			return 1;
+		s++;
+	}
+}
+
+
+static bool parse_u16(const char *s, uint8_t *p)
+{
+	unsigned long n;
+	char *end;
+
+	n = strtoul(s, &end, 0);
+	if ((*end && *end != ',') || n > 0xffff)
+		return 0;
+	p[0] = n;
+	p[1] = n >> 8;
+	return 1;
+}
+
+
+static bool parse_ext(const char *s, uint8_t *p)
+{
+	unsigned byte;
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		if (sscanf(s, "%2x", &byte) != 1)
+			return 0;
+		p[i] = byte;
+		s += 2;
+		if (*s == ':' && i)
+			s++;
+	}
+	return !*s || *s == ',';
+}
+
+
+int atusb_rx_filter_parse(const char *s, uint8_t *filter)
+{
+	unsigned long n;
+	char *end;
+	bool ok;
+
+	memset(filter, 0, ATUSB_RX_FILTER_SIZE);
+	while (*s) {
+		if (!strncmp(s, "type=", 5)) {
+			filter[0] |= ATUSB_RX_FILTER_TYPE;
+			ok = parse_types(s+5, filter+1);
+		} else if (!strncmp(s, "pan=", 4)) {
+			filter[0] |= ATUSB_RX_FILTER_PAN;
+			ok = parse_u16(s+4, filter+4);
+		} else if (!strncmp(s, "short=", 6)) {
+			filter[0] |= ATUSB_RX_FILTER_SHORT;
+			ok = parse_u16(s+6, filter+6);
+		} else if (!strncmp(s, "ext=", 4)) {
+			filter[0] |= ATUSB_RX_FILTER_EXT;
+			ok = parse_ext(s+4, filter+8);
+		} else if (!strncmp(s, "min=", 4)) {
+			filter[0] |= ATUSB_RX_FILTER_MIN_LEN;
+			n = strtoul(s+4, &end, 0);
+			ok = (!*end || *end == ',') && n <= 127;
+			filter[2] = n;
+		} else if (!strncmp(s, "bcast", 5) && (!s[5] || s[5] == ',')) {
+			filter[0] |= ATUSB_RX_FILTER_BROADCAST;
+			ok = 1;
+		} else if (!strncmp(s, "crc", 3) && (!s[3] || s[3] == ',')) {
+			filter[0] |= ATUSB_RX_FILTER_CRC;
+			ok = 1;
+		} else if (!strncmp(s, "hw", 2) && (!s[2] || s[2] == ',')) {
+			filter[0] |= ATUSB_RX_FILTER_HW;
+			ok = 1;
+		} else {
+			ok = 0;
+		}
+		if (!ok) {
+			fprintf(stderr, "bad filter \"%s\"\n", s);
+			return -1;
+		}
+		s += strcspn(s, ",");
+		if (*s)
+			s++;
+	}
+	return 0;
+}
+
+
+int atusb_hop_parse(const char *s, uint8_t *sched)
+{
+	uint8_t *e = sched;
+	unsigned long chan, us;
+	double ms;
+	char *end;
+
+	while (*s) {
+		if (e == sched+ATUSB_HOP_SLOTS*ATUSB_HOP_ENTRY_SIZE)
+			goto fail;
+		chan = strtoul(s, &end, 0);
+		if (end == s || chan > 26)
+			goto fail;
+		ms = ATUSB_HOP_DWELL_MS;
+		if (*end == '@') {
+			s = end+1;
+			ms = strtod(s, &end);
+			if (end == s)
+				goto fail;
+		}
+		if (*end && *end != ',')
+			goto fail;
+		/* also catches NaN, before the conversion could overflow */
+		if (!(ms > 0 && ms <= 0xffffff/1000.0))
+			goto fail;
+		us = ms*1000+0.5;
+		if (us < ATUSB_HOP_MIN_DWELL || us > 0xffffff)
+			goto fail;
+		*e++ = chan;
+		*e++ = us;
+		*e++ = us >> 8;
+		*e++ = us >> 16;
+		s = *end ? end+1 : end;
+	}
+	if (e != sched)
+		return e-sched;
+
+fail:
+	fprintf(stderr, "bad hopping schedule \"%s\"\n", s);
+	return -1;
+}
@@ -0,0 +1,138 @@
+/*
+ * lib/atusb-dev.h - Open and configure an ATUSB through libusb
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef ATUSB_DEV_H
+#define	ATUSB_DEV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libusb.h>
+
+
+#define	ATUSB_EP_FRAMES		0x81	/* bulk IN, frame records */
+#define	ATUSB_EP_TELEM		0x82	/* bulk IN, telemetry records */
+
+#define	ATUSB_TIMEOUT_MS	1000	/* control transfers */
+
+
+struct atusb_rx_stats {
+	uint32_t frames;	/* received */
+	uint32_t filtered;	/* dropped by the filter */
+	uint16_t overruns;	/* lost to a full ring */
+};
+
+struct atusb_bench_result {
+	uint16_t min, mean, max;	/* CPU cycles */
+	uint16_t errors;		/* runs with wrong data or state */
+};
+
+struct atusb_dev {
+	libusb_device_handle *h;
+	uint8_t hw_type;		/* ATUSB_HW_TYPE_* */
+	uint8_t major, minor;		/* EP0 protocol */
+	uint8_t bus, addr;
+};
+
+
+/*
+ * Open the nth (counting from zero) device with the given USB ID and claim
+ * its first interface, detaching the kernel driver if necessary.
+ */
+struct atusb_dev *atusb_open(libusb_context *ctx, uint16_t vendor,
+    uint16_t product, int nth);
+void atusb_close(struct atusb_dev *dev);
+
+int atusb_reg_write(struct atusb_dev *dev, uint8_t reg, uint8_t value);
+int atusb_reg_read(struct atusb_dev *dev, uint8_t reg);
+
+/* device time in 8 MHz ticks */
+int atusb_timer(struct atusb_dev *dev, uint64_t *ticks);
+
+/*
+ * Reset the transceiver, tune to the channel, and start reception in
+ * promiscuous mode with the given ATUSB_RX_MODE flags and, unless NULL,
+ * ATUSB_RX_FILTER payload.
+ */
+int atusb_rx_start(struct atusb_dev *dev, int channel, uint16_t flags,
+    const uint8_t *filter);
+int atusb_rx_stop(struct atusb_dev *dev);
+
+/* change the filter during reception, or turn it off with NULL */
+int atusb_rx_filter(struct atusb_dev *dev, const uint8_t *filter);
+int atusb_rx_stats(struct atusb_dev *dev, struct atusb_rx_stats *st);
+
+/*
+ * Sweep the channels in the mask (see ATUSB_SCAN) with "samples" ED
+ * measurements each, reporting on EP 2. channels = 0 stops.
+ */
+int atusb_scan(struct atusb_dev *dev, uint16_t channels, uint16_t samples);
+
+/*
+ * Calibrate the channels in the mask (see ATUSB_CHAN_CAL) and return the
+ * number of per-channel results stored in latency, or -1 on error.
+ */
+int atusb_chan_cal(struct atusb_dev *dev, uint16_t channels, uint8_t *latency,
+    int size);
+
+/* load an ATUSB_HOP schedule of len bytes and start hopping, or stop if 0 */
+int atusb_hop(struct atusb_dev *dev, const uint8_t *sched, int len);
+
+/* store a PSDU without FCS as template slot, or delete it if len is 0 */
+int atusb_template(struct atusb_dev *dev, uint8_t slot, const uint8_t *psdu,
+    int len);
+
+/*
+ * Send template slot after applying len bytes of ATUSB_TX_TEMPLATE patches.
+ * As with ATUSB_TX, seq comes back on EP 1 when the transmission is done.
+ */
+int atusb_tx_template(struct atusb_dev *dev, uint8_t slot, uint8_t seq,
+    const uint8_t *patch, int len);
+
+/*
+ * Send a PSDU without FCS when the device time (see atusb_timer) reaches
+ * ticks. seq comes back on EP 1 as for ATUSB_TX, and the time the frame
+ * actually went out in an ATUSB_TELEM_TX_AT record.
+ */
+int atusb_tx_at(struct atusb_dev *dev, uint64_t ticks, uint8_t seq,
+    const uint8_t *psdu, int len);
+
+/*
+ * Time an ATUSB_BENCH primitive, with "bytes" if it takes them (0 if not),
+ * on firmware built with "make bench".
+ */
+int atusb_bench(struct atusb_dev *dev, uint8_t primitive, uint8_t bytes,
+    struct atusb_bench_result *res);
+
+/*
+ * Parse a filter description, a comma-separated list of
+ * type=name[+name...], pan=id, short=addr, ext=eui64 (most significant byte
+ * first, optionally with colons), bcast, crc, hw, and min=bytes, where the
+ * names are beacon, data, ack, cmd, or a number.
+ */
+int atusb_rx_filter_parse(const char *s, uint8_t *filter);
+
+/*
+ * Parse a hopping schedule, a comma-separated list of channel[@ms], where ms
+ * is the dwell time in milliseconds (default: ATUSB_HOP_DWELL_MS), into an
+ * ATUSB_HOP payload. sched must hold ATUSB_HOP_SLOTS entries. Returns the
+ * payload size or -1.
+ */
+#define	ATUSB_HOP_DWELL_MS	100
+
+int atusb_hop_parse(const char *s, uint8_t *sched);
+
+/* convert a PHY_ED_LEVEL value to dBm, depending on the transceiver */
+float atusb_ed_to_dbm(const struct atusb_dev *dev, uint8_t ed);
+float atusb_hw_ed_to_dbm(uint8_t hw_type, uint8_t ed);
+
+#endif /* !ATUSB_DEV_H */
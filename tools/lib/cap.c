@@ -0,0 +1,254 @@
+/*
+ * lib/cap.c - Keep several bulk transfers in flight on the capture endpoint
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The device sends each record as one transfer and only has one or two
+ * packets buffered, so the host has to have the next transfer queued by the
+ * time a record is ready. We keep several transfers submitted and resubmit
+ * each one from its completion callback, before handing the record on.
+ *
+ * We also read the telemetry stream on EP 2, to learn about frames the
+ * device had to drop, and pass the other records on if asked to.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <libusb.h>
+
+#include "atusb/atusb.h"
+
+#include "atusb-dev.h"
+#include "telem.h"
+#include "cap.h"
+
+
+#define	REC_BUF		256	/* > largest record, 1+127+1+8 bytes */
+#define	TELEM_BUF	512
+
+
+struct atusb_cap {
+	libusb_context *ctx;
+	struct atusb_dev *dev;
+	atusb_cap_fn fn;
+	void *user;
+	int urbs;
+	struct libusb_transfer **xfers;
+	struct libusb_transfer *telem;
+	int active;
+	bool stopping;
+	struct atusb_cap_stats stats;
+
+	struct atusb_telem t;
+	atusb_telem_fn telem_fn;
+	void *telem_user;
+};
+
+
+uint64_t atusb_host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t) ts.tv_sec*1000000000+ts.tv_nsec;
+}
+
+
+/* ----- Telemetry --------------------------------------------------------- */
+
+
+static void telem_record(void *user, uint8_t type, const uint8_t *buf,
+    uint8_t len)
+{
+	struct atusb_cap *cap = user;
+	uint16_t v;
+
+	switch (type) {
+	case ATUSB_TELEM_RX_OVERRUN:
+	case ATUSB_TELEM_DROPPED:
+		if (len < 2)
+			return;
+		v = buf[0] | buf[1] << 8;
+		if (type == ATUSB_TELEM_RX_OVERRUN)
+			cap->stats.rx_overruns = v;
+		else
+			cap->stats.telem_dropped += v;
+		break;
+	default:
+		if (cap->telem_fn)
+			cap->telem_fn(cap->telem_user, type, buf, len);
+		break;
+	}
+}
+
+
+/* ----- Transfers --------------------------------------------------------- */
+
+
+static void done(struct atusb_cap *cap, struct libusb_transfer *xfer)
+{
+	if (!cap->stopping && !libusb_submit_transfer(xfer))
+		return;
+	cap->active--;
+}
+
+
+static void rec_cb(struct libusb_transfer *xfer)
+{
+	struct atusb_cap *cap = xfer->user_data;
+	uint64_t ns = atusb_host_ns();
+	uint8_t buf[REC_BUF];
+	int len = xfer->actual_length;
+
+	switch (xfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		/* resubmit first, so that the device never waits for us */
+		memcpy(buf, xfer->buffer, len);
+		done(cap, xfer);
+		cap->stats.records++;
+		cap->stats.bytes += len;
+		cap->fn(cap->user, buf, len, ns);
+		return;
+	case LIBUSB_TRANSFER_CANCELLED:
+		cap->active--;
+		return;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		cap->stats.errors++;
+		cap->stopping = 1;
+		cap->active--;
+		return;
+	default:
+		cap->stats.errors++;
+		done(cap, xfer);
+		return;
+	}
+}
+
+
+static void telem_cb(struct libusb_transfer *xfer)
+{
+	struct atusb_cap *cap = xfer->user_data;
+
+	if (xfer->status == LIBUSB_TRANSFER_COMPLETED)
+		atusb_telem_feed(&cap->t, xfer->buffer, xfer->actual_length,
+		    telem_record, cap);
+	if (xfer->status == LIBUSB_TRANSFER_CANCELLED ||
+	    xfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+		cap->active--;
+	else
+		done(cap, xfer);
+}
+
+
+static struct libusb_transfer *new_xfer(struct atusb_cap *cap, uint8_t ep,
+    int size, libusb_transfer_cb_fn cb)
+{
+	struct libusb_transfer *xfer;
+	uint8_t *buf;
+
+	xfer = libusb_alloc_transfer(0);
+	buf = malloc(size);
+	if (!xfer || !buf) {
+		perror("malloc");
+		exit(1);
+	}
+	libusb_fill_bulk_transfer(xfer, cap->dev->h, ep, buf, size, cb, cap,
+	    0);
+	if (libusb_submit_transfer(xfer)) {
+		libusb_free_transfer(xfer);
+		free(buf);
+		return NULL;
+	}
+	cap->active++;
+	return xfer;
+}
+
+
+static void free_xfer(struct libusb_transfer *xfer)
+{
+	if (!xfer)
+		return;
+	free(xfer->buffer);
+	libusb_free_transfer(xfer);
+}
+
+
+struct atusb_cap *atusb_cap_start(libusb_context *ctx, struct atusb_dev *dev,
+    int urbs, atusb_cap_fn fn, void *user)
+{
+	struct atusb_cap *cap;
+	int i;
+
+	cap = calloc(1, sizeof(*cap));
+	if (cap)
+		cap->xfers = calloc(urbs, sizeof(*cap->xfers));
+	if (!cap || !cap->xfers) {
+		perror("calloc");
+		exit(1);
+	}
+	cap->ctx = ctx;
+	cap->dev = dev;
+	cap->fn = fn;
+	cap->user = user;
+	cap->urbs = urbs;
+
+	for (i = 0; i != urbs; i++) {
+		cap->xfers[i] = new_xfer(cap, ATUSB_EP_FRAMES, REC_BUF,
+		    rec_cb);
+		if (!cap->xfers[i]) {
+			fprintf(stderr, "cannot submit transfer\n");
+			atusb_cap_stop(cap);
+			return NULL;
+		}
+	}
+	/* older firmware has no telemetry endpoint */
+	cap->telem = new_xfer(cap, ATUSB_EP_TELEM, TELEM_BUF, telem_cb);
+	return cap;
+}
+
+
+void atusb_cap_stop(struct atusb_cap *cap)
+{
+	int i;
+
+	cap->stopping = 1;
+	for (i = 0; i != cap->urbs; i++)
+		if (cap->xfers[i])
+			libusb_cancel_transfer(cap->xfers[i]);
+	if (cap->telem)
+		libusb_cancel_transfer(cap->telem);
+	while (cap->active)
+		libusb_handle_events(cap->ctx);
+	for (i = 0; i != cap->urbs; i++)
+		free_xfer(cap->xfers[i]);
+	free_xfer(cap->telem);
+	free(cap->xfers);
+	free(cap);
+}
+
+
+void atusb_cap_telem(struct atusb_cap *cap, atusb_telem_fn fn, void *user)
+{
+	cap->telem_fn = fn;
+	cap->telem_user = user;
+}
+
+
+const struct atusb_cap_stats *atusb_cap_stats(const struct atusb_cap *cap)
+{
+	return &cap->stats;
+}
@@ -0,0 +1,55 @@
+/*
+ * lib/cap.h - Keep several bulk transfers in flight on the capture endpoint
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef CAP_H
+#define	CAP_H
+
+#include <stdint.h>
+
+#include <libusb.h>
+
+#include "atusb-dev.h"
+#include "telem.h"
+
+
+#define	ATUSB_CAP_URBS		8	/* default number of transfers */
+
+
+struct atusb_cap_stats {
+	uint64_t records;	/* transfers completed on EP 1 */
+	uint64_t bytes;
+	uint64_t errors;	/* transfers that failed */
+	uint32_t rx_overruns;	/* frames the device had no room for */
+	uint32_t telem_dropped;	/* telemetry records the device lost */
+};
+
+/* called from libusb event handling, once per record */
+typedef void (*atusb_cap_fn)(void *user, const uint8_t *buf, int len,
+    uint64_t ns);
+
+struct atusb_cap;
+
+
+uint64_t atusb_host_ns(void);
+
+struct atusb_cap *atusb_cap_start(libusb_context *ctx, struct atusb_dev *dev,
+    int urbs, atusb_cap_fn fn, void *user);
+
+/* cancel all transfers and wait for them to finish */
+void atusb_cap_stop(struct atusb_cap *cap);
+
+/* get the telemetry records we don't handle ourselves */
+void atusb_cap_telem(struct atusb_cap *cap, atusb_telem_fn fn, void *user);
+
+const struct atusb_cap_stats *atusb_cap_stats(const struct atusb_cap *cap);
+
+#endif /* !CAP_H */
@@ -0,0 +1,264 @@
+/*
+ * lib/clksync.c - Map device time to host time
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Each sample is one ATUSB_TIMER request and we assume the device read its
+ * timer in the middle of the round trip. How wrong that is depends mostly on
+ * where in the USB frame the request happened to land, so samples with a
+ * long round trip are the least trustworthy. We therefore only keep the best
+ * of a burst of round trips, and of the recent samples only fit those whose
+ * round trip is within RTT_SLACK of the shortest one, but at least the best
+ * quarter, so that the fit still spans enough time if round trips vary a lot.
+ *
+ * The fit is a straight line, monotonic host time over device ticks, whose
+ * slope tracks the error of the device's crystal. The window slides, so the
+ * slope follows slow changes, e.g., with temperature, over long captures.
+ *
+ * We fit against CLOCK_MONOTONIC, which neither jumps nor is slewed, and only
+ * add the current offset of CLOCK_REALTIME when converting to wall time.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "atusb-dev.h"
+#include "rec.h"
+#include "clksync.h"
+
+
+#define	WINDOW		64		/* samples kept */
+#define	MIN_SPAN	8000000		/* ticks (1 s) needed to fit a slope */
+#define	MAX_PPM		1000		/* reject slopes further off */
+#define	RTT_SLACK	8		/* accept up to 1/RTT_SLACK above best */
+
+
+struct point {
+	uint64_t ticks;
+	uint64_t mono;		/* middle of the round trip */
+	uint64_t rtt;
+};
+
+struct clksync {
+	struct point pts[WINDOW];
+	int n, next;		/* points in use, next one to replace */
+	uint64_t last_ticks;
+	int64_t wall_off;
+
+	/* mono = ref_mono+offset+slope*(ticks-ref_ticks) */
+	uint64_t ref_ticks, ref_mono;
+	double offset, slope;
+	double residual;
+};
+
+
+uint64_t clksync_mono_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec*1000000000+ts.tv_nsec;
+}
+
+
+static int64_t wall_offset(void)
+{
+	struct timespec mono, wall;
+
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &wall);
+	return ((int64_t) wall.tv_sec-mono.tv_sec)*1000000000+
+	    (wall.tv_nsec-mono.tv_nsec);
+}
+
+
+struct clksync *clksync_new(void)
+{
+	struct clksync *cs;
+
+	cs = malloc(sizeof(struct clksync));
+	if (!cs) {
+		perror("malloc");
+		return NULL;
+	}
+	clksync_reset(cs);
+	return cs;
+}
+
+
+void clksync_free(struct clksync *cs)
+{
+	free(cs);
+}
+
+
+void clksync_reset(struct clksync *cs)
+{
+	memset(cs, 0, sizeof(*cs));
+	cs->slope = ATUSB_NS_PER_TICK;
+}
+
+
+/* ----- Fitting ----------------------------------------------------------- */
+
+
+static int by_rtt(const void *a, const void *b)
+{
+	const struct point *pa = *(const struct point * const *) a;
+	const struct point *pb = *(const struct point * const *) b;
+
+	return pa->rtt < pb->rtt ? -1 : pa->rtt > pb->rtt;
+}
+
+
+static void fit(struct clksync *cs)
+{
+	const struct point *use[WINDOW];
+	const struct point *p;
+	double x, y, sx = 0, sy = 0, sxx = 0, sxy = 0, ss = 0;
+	double slope, offset, d;
+	uint64_t lo = UINT64_MAX, hi = 0;
+	int n, i;
+
+	for (i = 0; i != cs->n; i++)
+		use[i] = cs->pts+i;
+	qsort(use, cs->n, sizeof(*use), by_rtt);
+	for (n = 1; n != cs->n; n++)
+		if (n >= (cs->n+3)/4 &&
+		    use[n]->rtt > use[0]->rtt+use[0]->rtt/RTT_SLACK)
+			break;
+
+	/* work relative to the newest point, to keep the doubles small */
+	p = cs->pts+(cs->next+WINDOW-1) % WINDOW;
+	cs->ref_ticks = p->ticks;
+	cs->ref_mono = p->mono;
+
+	for (i = 0; i != n; i++) {
+		x = (double) (int64_t) (use[i]->ticks-cs->ref_ticks);
+		y = (double) (int64_t) (use[i]->mono-cs->ref_mono);
+		sx += x;
+		sy += y;
+		sxx += x*x;
+		sxy += x*y;
+		if (use[i]->ticks < lo)
+			lo = use[i]->ticks;
+		if (use[i]->ticks > hi)
+			hi = use[i]->ticks;
+	}
+
+	slope = ATUSB_NS_PER_TICK;
+	if (hi-lo >= MIN_SPAN) {
+		d = n*sxx-sx*sx;
+		slope = (n*sxy-sx*sy)/d;
+		if (fabs(slope/ATUSB_NS_PER_TICK-1)*1e6 > MAX_PPM)
+			slope = ATUSB_NS_PER_TICK;
+	}
+	offset = (sy-slope*sx)/n;
+
+	for (i = 0; i != n; i++) {
+		x = (double) (int64_t) (use[i]->ticks-cs->ref_ticks);
+		y = (double) (int64_t) (use[i]->mono-cs->ref_mono);
+		d = y-offset-slope*x;
+		ss += d*d;
+	}
+	cs->slope = slope;
+	cs->offset = offset;
+	cs->residual = sqrt(ss/n);
+}
+
+
+/* ----- Samples ----------------------------------------------------------- */
+
+
+void clksync_add(struct clksync *cs, const struct clksync_sample *s)
+{
+	struct point *p;
+
+	/* the device's timer starts over when it is reset */
+	if (cs->n && s->ticks < cs->last_ticks)
+		clksync_reset(cs);
+	cs->last_ticks = s->ticks;
+	cs->wall_off = s->wall_off;
+
+	p = cs->pts+cs->next;
+	p->ticks = s->ticks;
+	p->mono = s->mono0+(s->mono1-s->mono0)/2;
+	p->rtt = s->mono1-s->mono0;
+	cs->next = (cs->next+1) % WINDOW;
+	if (cs->n < WINDOW)
+		cs->n++;
+	fit(cs);
+}
+
+
+int clksync_measure(struct clksync *cs, struct atusb_dev *dev, int rounds,
+    struct clksync_sample *s)
+{
+	struct clksync_sample best, tmp;
+	int i;
+
+	best.mono0 = 0;
+	best.mono1 = UINT64_MAX;
+	for (i = 0; i != rounds; i++) {
+		tmp.mono0 = clksync_mono_ns();
+		if (atusb_timer(dev, &tmp.ticks))
+			return -1;
+		tmp.mono1 = clksync_mono_ns();
+		if (tmp.mono1-tmp.mono0 < best.mono1-best.mono0)
+			best = tmp;
+	}
+	best.wall_off = wall_offset();
+	clksync_add(cs, &best);
+	if (s)
+		*s = best;
+	return 0;
+}
+
+
+/* ----- Conversion -------------------------------------------------------- */
+
+
+bool clksync_valid(const struct clksync *cs)
+{
+	return cs->n;
+}
+
+
+uint64_t clksync_mono(const struct clksync *cs, uint64_t ticks)
+{
+	double x = (double) (int64_t) (ticks-cs->ref_ticks);
+
+	return cs->ref_mono+(int64_t) llround(cs->offset+cs->slope*x);
+}
+
+
+uint64_t clksync_wall(const struct clksync *cs, uint64_t ticks)
+{
+	return clksync_mono(cs, ticks)+cs->wall_off;
+}
+
+
+double clksync_ppm(const struct clksync *cs)
+{
+	return (ATUSB_NS_PER_TICK/cs->slope-1)*1e6;
+}
+
+
+double clksync_residual(const struct clksync *cs)
+{
+	return cs->residual;
+}
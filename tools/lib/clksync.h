@@ -0,0 +1,62 @@
+/*
+ * lib/clksync.h - Map device time to host time
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef CLKSYNC_H
+#define	CLKSYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "atusb-dev.h"
+
+
+#define	CLKSYNC_ROUNDS		8	/* round trips per measurement */
+#define	CLKSYNC_INTERVAL_MS	1000	/* suggested time between measurements */
+
+
+struct clksync_sample {
+	uint64_t ticks;		/* device time ... */
+	uint64_t mono0, mono1;	/* ... read between these CLOCK_MONOTONIC ns */
+	int64_t wall_off;	/* CLOCK_REALTIME minus CLOCK_MONOTONIC */
+};
+
+struct clksync;
+
+
+uint64_t clksync_mono_ns(void);
+
+struct clksync *clksync_new(void);
+void clksync_free(struct clksync *cs);
+
+/* forget all samples, e.g., after the device was reset */
+void clksync_reset(struct clksync *cs);
+
+/*
+ * Read the device's timer "rounds" times, add the sample with the shortest
+ * round trip, and refit. If "s" is not NULL, the sample is also returned, so
+ * that it can be recorded and fed to clksync_add on replay.
+ */
+int clksync_measure(struct clksync *cs, struct atusb_dev *dev, int rounds,
+    struct clksync_sample *s);
+void clksync_add(struct clksync *cs, const struct clksync_sample *s);
+
+bool clksync_valid(const struct clksync *cs);
+
+/* convert device ticks to CLOCK_MONOTONIC or CLOCK_REALTIME ns */
+uint64_t clksync_mono(const struct clksync *cs, uint64_t ticks);
+uint64_t clksync_wall(const struct clksync *cs, uint64_t ticks);
+
+/* crystal error in ppm (positive if fast) and RMS residual of the fit in ns */
+double clksync_ppm(const struct clksync *cs);
+double clksync_residual(const struct clksync *cs);
+
+#endif /* !CLKSYNC_H */
@@ -0,0 +1,275 @@
+/*
+ * lib/pcapng.c - Write IEEE 802.15.4 captures in pcapng format
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-02.html
+ * https://github.com/jkcko/ieee802.15.4-tap
+ *
+ * We write host byte order, which the section header's byte-order magic
+ * tells readers about. Each packet is prefixed by an IEEE 802.15.4 TAP
+ * header with FCS type, RSS, channel, and LQI TLVs. The TAP header is part
+ * of the packet data and always little-endian.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pcapng.h"
+
+
+#define	BT_SHB		0x0a0d0d0a
+#define	BT_IDB		0x00000001
+#define	BT_EPB		0x00000006
+
+#define	OPT_ENDOFOPT	0
+#define	OPT_SHB_USERAPPL 4
+#define	OPT_IF_NAME	2
+#define	OPT_IF_DESCR	3
+#define	OPT_IF_TSRESOL	9
+#define	OPT_EPB_FLAGS	2
+
+#define	EPB_FLAG_CRC_ERROR (1 << 24)
+
+#define	TAP_FCS_TYPE	0
+#define	TAP_RSS		1
+#define	TAP_CHANNEL	3
+#define	TAP_LQI		10
+
+#define	TAP_FCS_16	1
+
+#define	SNAPLEN		(127+64)	/* PSDU plus TAP header */
+
+
+struct pcapng {
+	FILE *file;
+	int interfaces;
+	uint8_t *buf;
+	size_t len, size;
+};
+
+
+/* ----- Block assembly ---------------------------------------------------- */
+
+
+static void put(struct pcapng *p, const void *data, size_t len)
+{
+	if (p->len+len > p->size) {
+		p->size = (p->len+len)*2;
+		p->buf = realloc(p->buf, p->size);
+		if (!p->buf) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	memcpy(p->buf+p->len, data, len);
+	p->len += len;
+}
+
+
+static void put_u16(struct pcapng *p, uint16_t v)
+{
+	put(p, &v, 2);
+}
+
+
+static void put_u32(struct pcapng *p, uint32_t v)
+{
+	put(p, &v, 4);
+}
+
+
+static void pad(struct pcapng *p)
+{
+	static const uint8_t zero[4];
+
+	put(p, zero, -p->len & 3);
+}
+
+
+static void put_opt(struct pcapng *p, uint16_t code, const void *data,
+    uint16_t len)
+{
+	put_u16(p, code);
+	put_u16(p, len);
+	put(p, data, len);
+	pad(p);
+}
+
+
+static void begin(struct pcapng *p, uint32_t type)
+{
+	p->len = 0;
+	put_u32(p, type);
+	put_u32(p, 0);		/* length, filled in by end() */
+}
+
+
+static int end(struct pcapng *p)
+{
+	uint32_t total;
+
+	pad(p);
+	total = p->len+4;
+	put_u32(p, total);
+	memcpy(p->buf+4, &total, 4);
+	if (fwrite(p->buf, 1, p->len, p->file) != p->len) {
+		perror("fwrite");
+		return -1;
+	}
+	return 0;
+}
+
+
+/* ----- Blocks ------------------------------------------------------------ */
+
+
+struct pcapng *pcapng_open(FILE *file)
+{
+	static const char appl[] = "atusb-attacks host tools";
+	struct pcapng *p;
+
+	p = calloc(1, sizeof(*p));
+	if (!p) {
+		perror("calloc");
+		exit(1);
+	}
+	p->file = file;
+
+	begin(p, BT_SHB);
+	put_u32(p, 0x1a2b3c4d);		/* byte-order magic */
+	put_u16(p, 1);			/* major version */
+	put_u16(p, 0);			/* minor version */
+	put_u32(p, 0xffffffff);		/* section length: unknown */
+	put_u32(p, 0xffffffff);
+	put_opt(p, OPT_SHB_USERAPPL, appl, strlen(appl));
+	put_u32(p, OPT_ENDOFOPT);
+	if (end(p)) {
+		free(p->buf);
+		free(p);
+		return NULL;
+	}
+	return p;
+}
+
+
+int pcapng_add_if(struct pcapng *p, const char *name, const char *descr)
+{
+	uint8_t tsresol = 9;		/* 10^-9 s */
+
+	begin(p, BT_IDB);
+	put_u16(p, LINKTYPE_IEEE802_15_4_TAP);
+	put_u16(p, 0);			/* reserved */
+	put_u32(p, SNAPLEN);
+	if (name)
+		put_opt(p, OPT_IF_NAME, name, strlen(name));
+	if (descr)
+		put_opt(p, OPT_IF_DESCR, descr, strlen(descr));
+	put_opt(p, OPT_IF_TSRESOL, &tsresol, 1);
+	put_u32(p, OPT_ENDOFOPT);
+	if (end(p))
+		return -1;
+	return p->interfaces++;
+}
+
+
+static void put_le16(struct pcapng *p, uint16_t v)
+{
+	uint8_t b[2] = { v, v >> 8 };
+
+	put(p, b, 2);
+}
+
+
+static void put_tlv(struct pcapng *p, uint16_t type, const void *data,
+    uint16_t len)
+{
+	put_le16(p, type);
+	put_le16(p, len);
+	put(p, data, len);
+	pad(p);
+}
+
+
+static uint16_t tap_header(struct pcapng *p, const struct pcapng_tap *tap)
+{
+	size_t start = p->len;
+	uint8_t fcs = TAP_FCS_16;
+	uint16_t len;
+	uint32_t rss;
+	uint8_t buf[4];
+
+	put(p, "\0\0", 2);		/* version, reserved */
+	put_le16(p, 0);			/* length, below */
+	put_tlv(p, TAP_FCS_TYPE, &fcs, 1);
+	if (tap->has_rss) {
+		memcpy(&rss, &tap->rss, 4);	/* IEEE 754 single */
+		buf[0] = rss;
+		buf[1] = rss >> 8;
+		buf[2] = rss >> 16;
+		buf[3] = rss >> 24;
+		put_tlv(p, TAP_RSS, buf, 4);
+	}
+	if (tap->channel >= 0) {
+		buf[0] = tap->channel;
+		buf[1] = tap->channel >> 8;
+		buf[2] = tap->page;
+		put_tlv(p, TAP_CHANNEL, buf, 3);
+	}
+	if (tap->has_lqi)
+		put_tlv(p, TAP_LQI, &tap->lqi, 1);
+	len = p->len-start;
+	p->buf[start+2] = len;
+	p->buf[start+3] = len >> 8;
+	return len;
+}
+
+
+int pcapng_packet(struct pcapng *p, int itf, uint64_t ns,
+    const uint8_t *psdu, uint8_t len, const struct pcapng_tap *tap)
+{
+	size_t cap_len_pos;
+	uint32_t cap_len, flags;
+
+	begin(p, BT_EPB);
+	put_u32(p, itf);
+	put_u32(p, ns >> 32);
+	put_u32(p, ns);
+	cap_len_pos = p->len;
+	put_u32(p, 0);			/* captured length, below */
+	put_u32(p, 0);			/* original length, below */
+	cap_len = tap_header(p, tap)+len;
+	put(p, psdu, len);
+	pad(p);
+	memcpy(p->buf+cap_len_pos, &cap_len, 4);
+	memcpy(p->buf+cap_len_pos+4, &cap_len, 4);
+	if (tap->crc_known) {
+		flags = tap->crc_ok ? 0 : EPB_FLAG_CRC_ERROR;
+		put_opt(p, OPT_EPB_FLAGS, &flags, 4);
+		put_u32(p, OPT_ENDOFOPT);
+	}
+	return end(p);
+}
+
+
+int pcapng_close(struct pcapng *p)
+{
+	int res;
+
+	res = fflush(p->file) ? -1 : 0;
+	free(p->buf);
+	free(p);
+	return res;
+}
@@ -0,0 +1,54 @@
+/*
+ * lib/pcapng.h - Write IEEE 802.15.4 captures in pcapng format
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PCAPNG_H
+#define	PCAPNG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+#define	LINKTYPE_IEEE802_15_4_TAP	283
+
+
+/* per-packet metadata, carried in the TAP header */
+
+struct pcapng_tap {
+	bool has_rss;
+	float rss;		/* dBm */
+	bool has_lqi;
+	uint8_t lqi;
+	int channel;		/* < 0 if unknown */
+	int page;
+	bool crc_known;		/* ... then crc_ok goes into epb_flags */
+	bool crc_ok;
+};
+
+struct pcapng;
+
+
+struct pcapng *pcapng_open(FILE *file);
+
+/*
+ * Add an interface (one per capturing device) and return its ID. Timestamps
+ * are in nanoseconds.
+ */
+int pcapng_add_if(struct pcapng *p, const char *name, const char *descr);
+
+/* the PSDU includes the FCS */
+int pcapng_packet(struct pcapng *p, int itf, uint64_t ns,
+    const uint8_t *psdu, uint8_t len, const struct pcapng_tap *tap);
+
+int pcapng_close(struct pcapng *p);
+
+#endif /* !PCAPNG_H */
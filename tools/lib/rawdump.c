@@ -0,0 +1,169 @@
+/*
+ * lib/rawdump.c - Record and replay the raw EP 1 record stream
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clksync.h"
+#include "rawdump.h"
+
+
+#define	MAGIC		"ATUSBRAW"
+#define	VERSION		2
+#define	HDR_SIZE	32
+#define	REC_HDR_SIZE	10
+#define	MAX_REC		256
+#define	SYNC_LEN	0xffff	/* length field of a clock sync record */
+#define	SYNC_SIZE	32
+
+
+static void put_le(uint8_t *p, uint64_t v, int bytes)
+{
+	while (bytes--) {
+		*p++ = v;
+		v >>= 8;
+	}
+}
+
+
+static uint64_t get_le(const uint8_t *p, int bytes)
+{
+	uint64_t v = 0;
+
+	while (bytes--)
+		v = v << 8 | p[bytes];
+	return v;
+}
+
+
+int rawdump_write_hdr(FILE *file, const struct rawdump_hdr *hdr)
+{
+	uint8_t buf[HDR_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, MAGIC, 8);
+	buf[8] = VERSION;
+	buf[9] = hdr->hw_type;
+	put_le(buf+16, hdr->ticks, 8);
+	put_le(buf+24, hdr->ns, 8);
+	if (fwrite(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+		perror("fwrite");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rawdump_write(FILE *file, const uint8_t *buf, int len, uint64_t ns)
+{
+	uint8_t hdr[REC_HDR_SIZE];
+
+	put_le(hdr, len, 2);
+	put_le(hdr+2, ns, 8);
+	if (fwrite(hdr, 1, sizeof(hdr), file) != sizeof(hdr) ||
+	    fwrite(buf, 1, len, file) != (size_t) len) {
+		perror("fwrite");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rawdump_write_sync(FILE *file, const struct clksync_sample *s,
+    uint64_t ns)
+{
+	uint8_t buf[REC_HDR_SIZE+SYNC_SIZE];
+
+	put_le(buf, SYNC_LEN, 2);
+	put_le(buf+2, ns, 8);
+	put_le(buf+REC_HDR_SIZE, s->ticks, 8);
+	put_le(buf+REC_HDR_SIZE+8, s->mono0, 8);
+	put_le(buf+REC_HDR_SIZE+16, s->mono1, 8);
+	put_le(buf+REC_HDR_SIZE+24, s->wall_off, 8);
+	if (fwrite(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+		perror("fwrite");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rawdump_read_hdr(FILE *file, struct rawdump_hdr *hdr)
+{
+	uint8_t buf[HDR_SIZE];
+
+	if (fread(buf, 1, sizeof(buf), file) != sizeof(buf) ||
+	    memcmp(buf, MAGIC, 8)) {
+		fprintf(stderr, "not a raw ATUSB dump\n");
+		return -1;
+	}
+	if (buf[8] < 1 || buf[8] > VERSION) {
+		fprintf(stderr, "raw dump version %u not supported\n", buf[8]);
+		return -1;
+	}
+	hdr->hw_type = buf[9];
+	hdr->ticks = get_le(buf+16, 8);
+	hdr->ns = get_le(buf+24, 8);
+	return 0;
+}
+
+
+static int read_sync(FILE *file, rawdump_sync_fn sync_fn, void *user)
+{
+	uint8_t buf[SYNC_SIZE];
+	struct clksync_sample s;
+
+	if (fread(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+		fprintf(stderr, "raw dump truncated\n");
+		return -1;
+	}
+	s.ticks = get_le(buf, 8);
+	s.mono0 = get_le(buf+8, 8);
+	s.mono1 = get_le(buf+16, 8);
+	s.wall_off = get_le(buf+24, 8);
+	if (sync_fn)
+		sync_fn(user, &s);
+	return 1;
+}
+
+
+int rawdump_read(FILE *file, rawdump_fn fn, rawdump_sync_fn sync_fn,
+    void *user)
+{
+	uint8_t hdr[REC_HDR_SIZE], buf[MAX_REC];
+	size_t got;
+	int len;
+
+	got = fread(hdr, 1, sizeof(hdr), file);
+	if (!got && feof(file))
+		return 0;
+	if (got != sizeof(hdr))
+		goto truncated;
+	len = get_le(hdr, 2);
+	if (len == SYNC_LEN)
+		return read_sync(file, sync_fn, user);
+	if (len > MAX_REC) {
+		fprintf(stderr, "raw dump record too long (%d bytes)\n", len);
+		return -1;
+	}
+	if (fread(buf, 1, len, file) != (size_t) len)
+		goto truncated;
+	fn(user, buf, len, get_le(hdr+2, 8));
+	return 1;
+
+truncated:
+	fprintf(stderr, "raw dump truncated\n");
+	return -1;
+}
@@ -0,0 +1,61 @@
+/*
+ * lib/rawdump.h - Record and replay the raw EP 1 record stream
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef RAWDUMP_H
+#define	RAWDUMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clksync.h"
+
+
+/*
+ * File format, all little-endian:
+ *
+ * header:	"ATUSBRAW", u8 version (2), u8 hw_type, 6 bytes zero,
+ *		u64 device ticks and u64 host ns of one common instant
+ * records:	u16 length, u64 host ns at reception, length bytes
+ * clock sync:	u16 0xffff, u64 host ns, then u64 ticks, u64 mono0,
+ *		u64 mono1, and s64 wall_off of a struct clksync_sample
+ *
+ * Version 1 files have no clock sync records.
+ */
+
+struct rawdump_hdr {
+	uint8_t hw_type;
+	uint64_t ticks;		/* device time ... */
+	uint64_t ns;		/* ... and host time of the same instant */
+};
+
+typedef void (*rawdump_fn)(void *user, const uint8_t *buf, int len,
+    uint64_t ns);
+typedef void (*rawdump_sync_fn)(void *user, const struct clksync_sample *s);
+
+
+int rawdump_write_hdr(FILE *file, const struct rawdump_hdr *hdr);
+int rawdump_write(FILE *file, const uint8_t *buf, int len, uint64_t ns);
+int rawdump_write_sync(FILE *file, const struct clksync_sample *s,
+    uint64_t ns);
+
+int rawdump_read_hdr(FILE *file, struct rawdump_hdr *hdr);
+
+/*
+ * Read the next record and pass it to fn, or to sync_fn if it is a clock
+ * sync. sync_fn can be NULL. Returns 1 if there was a record, 0 at the end of
+ * the file, and -1 on error.
+ */
+int rawdump_read(FILE *file, rawdump_fn fn, rawdump_sync_fn sync_fn,
+    void *user);
+
+#endif /* !RAWDUMP_H */
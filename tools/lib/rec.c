@@ -0,0 +1,63 @@
+/*
+ * lib/rec.c - Decode the records the ATUSB sends on EP 1
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * A frame record is the PHR (length), the PSDU, the LQI, and, if the host
+ * asked for it, the trailer described in atusb.h. One-byte records are
+ * either the sequence number of a frame we sent, or, with the high bit set,
+ * a counter of interrupts that didn't produce a frame.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "atusb/atusb.h"
+
+#include "rec.h"
+
+
+enum atusb_rec_type atusb_rec_decode(const uint8_t *buf, int len,
+    struct atusb_frame *f)
+{
+	const uint8_t *t;
+	int i;
+
+	if (len == 1)
+		return buf[0] & 0x80 ? atusb_rec_irq : atusb_rec_tx_done;
+	if (len < 2 || buf[0] > 127)
+		return atusb_rec_bad;
+
+	f->len = buf[0];
+	f->psdu = buf+1;
+	if (len == f->len+2) {
+		f->has_trailer = 0;
+	} else if (len == f->len+2+ATUSB_RX_TRAILER_SIZE) {
+		f->has_trailer = 1;
+	} else {
+		return atusb_rec_bad;
+	}
+	f->lqi = buf[f->len+1];
+	if (!f->has_trailer) {
+		f->ed = f->flags = 0;
+		f->ticks = 0;
+		return atusb_rec_frame;
+	}
+
+	t = buf+f->len+2;
+	f->ed = t[0];
+	f->flags = t[1];
+	f->ticks = 0;
+	for (i = 7; i != 1; i--)
+		f->ticks = f->ticks << 8 | t[i];
+	return atusb_rec_frame;
+}
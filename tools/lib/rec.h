@@ -0,0 +1,60 @@
+/*
+ * lib/rec.h - Decode the records the ATUSB sends on EP 1
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef REC_H
+#define	REC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "atusb/atusb.h"
+
+
+#define	ATUSB_NS_PER_TICK	125	/* timer 1 runs at 8 MHz */
+
+
+enum atusb_rec_type {
+	atusb_rec_frame,	/* received frame */
+	atusb_rec_tx_done,	/* sequence number of a sent frame */
+	atusb_rec_irq,		/* interrupt without a frame */
+	atusb_rec_bad,		/* doesn't parse */
+};
+
+struct atusb_frame {
+	const uint8_t *psdu;	/* including the FCS */
+	uint8_t len;
+	uint8_t lqi;
+	bool has_trailer;
+	uint8_t ed;		/* PHY_ED_LEVEL */
+	uint8_t flags;		/* ATUSB_RX_FLAG_* */
+	uint64_t ticks;		/* device time at TRX_END */
+};
+
+
+/*
+ * Each USB transfer on EP 1 carries exactly one record. The frame points
+ * into buf.
+ */
+enum atusb_rec_type atusb_rec_decode(const uint8_t *buf, int len,
+    struct atusb_frame *f);
+
+static inline bool atusb_frame_crc_known(const struct atusb_frame *f)
+{
+	return f->has_trailer && (f->flags & ATUSB_RX_FLAG_CRC_KNOWN);
+}
+
+static inline bool atusb_frame_crc_ok(const struct atusb_frame *f)
+{
+	return f->flags & ATUSB_RX_FLAG_CRC_VALID;
+}
+
+#endif /* !REC_H */
@@ -0,0 +1,333 @@
+/*
+ * lib/shmring.c - Shared-memory ring of captured frames, one writer, many
+ *		   readers
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Frame n goes into slot n % slots. Each slot carries the number (plus one)
+ * of the frame in it, which the writer clears while it rewrites the slot,
+ * like a seqlock. A reader checks that number before and after using the
+ * frame, so it can tell if the writer lapped it, without the writer ever
+ * having to wait for or even know about readers.
+ *
+ * Readers register in a small table in the header, with their position and
+ * overrun count, so that all of this can be inspected from outside.
+ */
+
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmring.h"
+
+
+#define	MAGIC		0x52555441	/* "ATUR" */
+#define	VERSION		1
+
+
+struct consumer {
+	_Atomic uint32_t pid;		/* 0 if the entry is free */
+	_Atomic uint64_t cursor;	/* next frame to read */
+	_Atomic uint64_t overruns;
+};
+
+struct slot {
+	_Atomic uint64_t seq;		/* frame number+1, 0 while writing */
+	struct shmring_frame f;
+};
+
+struct hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t slot_size;
+	_Atomic uint32_t writer_pid;	/* 0 once the writer is gone */
+	alignas(64) _Atomic uint64_t head; /* number of the next frame */
+	alignas(64) struct consumer consumer[SHMRING_CONSUMERS];
+	alignas(64) struct slot slot[];
+};
+
+struct shmring {
+	char *name;
+	struct hdr *hdr;
+	size_t size;
+};
+
+struct shmring_reader {
+	struct hdr *hdr;
+	size_t size;
+	struct consumer *c;
+	const struct slot *cur;		/* slot handed out by shmring_next */
+	uint64_t seq;			/* ... and the frame we expect in it */
+};
+
+
+static size_t ring_size(uint32_t slots)
+{
+	return sizeof(struct hdr)+slots*sizeof(struct slot);
+}
+
+
+/* ----- Writer ------------------------------------------------------------ */
+
+
+struct shmring *shmring_create(const char *name, uint32_t slots)
+{
+	struct shmring *ring;
+	int fd;
+
+	if (!slots || (slots & (slots-1))) {
+		fprintf(stderr, "ring size must be a power of two\n");
+		return NULL;
+	}
+	ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		perror("calloc");
+		exit(1);
+	}
+	ring->name = strdup(name);
+	ring->size = ring_size(slots);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(name);
+		goto fail;
+	}
+	if (ftruncate(fd, ring->size) < 0) {
+		perror("ftruncate");
+		close(fd);
+		goto fail_unlink;
+	}
+	ring->hdr = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    fd, 0);
+	close(fd);
+	if (ring->hdr == MAP_FAILED) {
+		perror("mmap");
+		goto fail_unlink;
+	}
+
+	/* the file is all zero, so all consumers and slots are free */
+	ring->hdr->slots = slots;
+	ring->hdr->slot_size = sizeof(struct slot);
+	ring->hdr->version = VERSION;
+	atomic_store(&ring->hdr->writer_pid, getpid());
+	atomic_store(&ring->hdr->head, 0);
+	/* readers only look at the rest after seeing the magic number */
+	atomic_thread_fence(memory_order_release);
+	ring->hdr->magic = MAGIC;
+	return ring;
+
+fail_unlink:
+	shm_unlink(name);
+fail:
+	free(ring->name);
+	free(ring);
+	return NULL;
+}
+
+
+void shmring_put(struct shmring *ring, const struct shmring_frame *f)
+{
+	struct hdr *h = ring->hdr;
+	uint64_t n;
+	struct slot *s;
+
+	n = atomic_load_explicit(&h->head, memory_order_relaxed);
+	s = h->slot+(n & (h->slots-1));
+	atomic_store_explicit(&s->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(&s->f, f, sizeof(*f));
+	atomic_store_explicit(&s->seq, n+1, memory_order_release);
+	atomic_store_explicit(&h->head, n+1, memory_order_release);
+}
+
+
+void shmring_destroy(struct shmring *ring)
+{
+	atomic_store(&ring->hdr->writer_pid, 0);
+	munmap(ring->hdr, ring->size);
+	shm_unlink(ring->name);
+	free(ring->name);
+	free(ring);
+}
+
+
+/* ----- Readers ----------------------------------------------------------- */
+
+
+static bool pid_alive(uint32_t pid)
+{
+	return pid && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+
+static struct consumer *claim(struct hdr *h)
+{
+	struct consumer *c;
+	uint32_t pid;
+	int pass;
+
+	/* first look for a free entry, then for one left by a dead reader */
+	for (pass = 0; pass != 2; pass++)
+		for (c = h->consumer; c != h->consumer+SHMRING_CONSUMERS;
+		    c++) {
+			pid = atomic_load(&c->pid);
+			if (pass ? pid_alive(pid) : pid != 0)
+				continue;
+			if (atomic_compare_exchange_strong(&c->pid, &pid,
+			    getpid()))
+				return c;
+		}
+	return NULL;
+}
+
+
+struct shmring_reader *shmring_attach(const char *name)
+{
+	struct shmring_reader *r;
+	struct stat st;
+	struct hdr *h;
+	int fd;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) {
+		perror(name);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0) {
+		perror("fstat");
+		close(fd);
+		return NULL;
+	}
+	if ((size_t) st.st_size < sizeof(struct hdr)) {
+		fprintf(stderr, "%s: not a frame ring\n", name);
+		close(fd);
+		return NULL;
+	}
+	h = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (h == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	if (h->magic != MAGIC || h->version != VERSION ||
+	    h->slot_size != sizeof(struct slot) ||
+	    (size_t) st.st_size < ring_size(h->slots)) {
+		fprintf(stderr, "%s: not a frame ring, or a different version\n",
+		    name);
+		goto fail;
+	}
+	atomic_thread_fence(memory_order_acquire);
+
+	r = calloc(1, sizeof(*r));
+	if (!r) {
+		perror("calloc");
+		exit(1);
+	}
+	r->hdr = h;
+	r->size = st.st_size;
+	r->c = claim(h);
+	if (!r->c) {
+		fprintf(stderr, "%s: too many readers\n", name);
+		free(r);
+		goto fail;
+	}
+	atomic_store(&r->c->overruns, 0);
+	atomic_store(&r->c->cursor, atomic_load(&h->head));
+	return r;
+
+fail:
+	munmap(h, st.st_size);
+	return NULL;
+}
+
+
+void shmring_detach(struct shmring_reader *r)
+{
+	atomic_store(&r->c->pid, 0);
+	munmap(r->hdr, r->size);
+	free(r);
+}
+
+
+static void lost(struct shmring_reader *r, uint64_t n)
+{
+	atomic_fetch_add_explicit(&r->c->overruns, n, memory_order_relaxed);
+}
+
+
+const struct shmring_frame *shmring_next(struct shmring_reader *r)
+{
+	struct hdr *h = r->hdr;
+	uint64_t cursor, head;
+	const struct slot *s;
+
+	cursor = atomic_load_explicit(&r->c->cursor, memory_order_relaxed);
+	while (1) {
+		head = atomic_load_explicit(&h->head, memory_order_acquire);
+		if (cursor == head)
+			break;
+		if (head-cursor > h->slots) {
+			lost(r, head-h->slots-cursor);
+			cursor = head-h->slots;
+		}
+		s = h->slot+(cursor & (h->slots-1));
+		if (atomic_load_explicit(&s->seq, memory_order_acquire) ==
+		    cursor+1) {
+			r->cur = s;
+			r->seq = cursor;
+			return &s->f;
+		}
+		/* the writer has already come around again */
+		lost(r, 1);
+		cursor++;
+	}
+	atomic_store_explicit(&r->c->cursor, cursor, memory_order_relaxed);
+	return NULL;
+}
+
+
+bool shmring_done(struct shmring_reader *r)
+{
+	bool ok;
+
+	atomic_thread_fence(memory_order_acquire);
+	ok = atomic_load_explicit(&r->cur->seq, memory_order_relaxed) ==
+	    r->seq+1;
+	if (!ok)
+		lost(r, 1);
+	atomic_store_explicit(&r->c->cursor, r->seq+1, memory_order_relaxed);
+	r->cur = NULL;
+	return ok;
+}
+
+
+uint64_t shmring_overruns(const struct shmring_reader *r)
+{
+	return atomic_load(&r->c->overruns);
+}
+
+
+bool shmring_alive(const struct shmring_reader *r)
+{
+	return pid_alive(atomic_load(&r->hdr->writer_pid));
+}
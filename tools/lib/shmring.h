@@ -0,0 +1,81 @@
+/*
+ * lib/shmring.h - Shared-memory ring of captured frames, one writer, many
+ *		   readers
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SHMRING_H
+#define	SHMRING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define	SHMRING_SLOTS		4096	/* default, power of two */
+#define	SHMRING_CONSUMERS	16
+
+
+/* one decoded frame, as it sits in the ring */
+
+struct shmring_frame {
+	uint64_t ns;		/* host time of the frame, see atusb-cap */
+	uint16_t itf;		/* capturing device */
+	uint8_t len;		/* PSDU length, including the FCS */
+	uint8_t lqi;
+	uint8_t ed;		/* PHY_ED_LEVEL, if SHMRING_F_TRAILER */
+	uint8_t channel;
+	uint8_t flags;		/* SHMRING_F_* */
+	uint8_t reserved;
+	float rss;		/* dBm, if SHMRING_F_TRAILER */
+	uint8_t psdu[127];
+};
+
+#define	SHMRING_F_TRAILER	0x01	/* ed, rss, and CRC flags are valid */
+#define	SHMRING_F_CRC_KNOWN	0x02
+#define	SHMRING_F_CRC_OK	0x04
+
+struct shmring;
+struct shmring_reader;
+
+
+/* ----- Writer ------------------------------------------------------------ */
+
+/*
+ * Create the ring as POSIX shared memory object "name" (e.g., "/atusb").
+ * The writer never waits for readers: a reader that falls more than a ring
+ * behind loses frames and sees its overrun count go up.
+ */
+struct shmring *shmring_create(const char *name, uint32_t slots);
+void shmring_put(struct shmring *ring, const struct shmring_frame *f);
+void shmring_destroy(struct shmring *ring);
+
+
+/* ----- Readers ----------------------------------------------------------- */
+
+/* attach as a new consumer, starting with the next frame written */
+struct shmring_reader *shmring_attach(const char *name);
+void shmring_detach(struct shmring_reader *r);
+
+/*
+ * Return the next frame, pointing into the ring, or NULL if there is none
+ * yet. The frame stays valid until shmring_done, which returns 0 if the
+ * writer overwrote it in the meantime; the reader must then discard what it
+ * got from it.
+ */
+const struct shmring_frame *shmring_next(struct shmring_reader *r);
+bool shmring_done(struct shmring_reader *r);
+
+/* frames this reader lost so far */
+uint64_t shmring_overruns(const struct shmring_reader *r);
+
+/* false once the writer has gone away */
+bool shmring_alive(const struct shmring_reader *r);
+
+#endif /* !SHMRING_H */
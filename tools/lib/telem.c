@@ -0,0 +1,42 @@
+/*
+ * lib/telem.c - Split the EP 2 byte stream into telemetry records
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+
+#include <stdint.h>
+
+#include "telem.h"
+
+
+void atusb_telem_feed(struct atusb_telem *t, const uint8_t *p, int len,
+    atusb_telem_fn fn, void *user)
+{
+	while (len--) {
+		switch (t->state) {
+		case 0:
+			t->type = *p++;
+			t->state = 1;
+			break;
+		case 1:
+			t->len = *p++;
+			t->got = 0;
+			t->state = 2;
+			break;
+		default:
+			t->buf[t->got++] = *p++;
+			break;
+		}
+		if (t->state == 2 && t->got == t->len) {
+			fn(user, t->type, t->buf, t->len);
+			t->state = 0;
+		}
+	}
+}
@@ -0,0 +1,36 @@
+/*
+ * lib/telem.h - Split the EP 2 byte stream into telemetry records
+ *
+ * Written 2026 by agent
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef TELEM_H
+#define	TELEM_H
+
+#include <stdint.h>
+
+
+struct atusb_telem {
+	uint8_t type, len, got;
+	uint8_t state;		/* 0: type, 1: length, 2: payload */
+	uint8_t buf[255];
+};
+
+typedef void (*atusb_telem_fn)(void *user, uint8_t type, const uint8_t *buf,
+    uint8_t len);
+
+
+/*
+ * Feed bytes as they arrive, in transfers of any size. fn is called once per
+ * complete record. Start with a zeroed struct atusb_telem.
+ */
+void atusb_telem_feed(struct atusb_telem *t, const uint8_t *p, int len,
+    atusb_telem_fn fn, void *user);
+
+#endif /* !TELEM_H */